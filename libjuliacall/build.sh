@@ -17,6 +17,7 @@ lib_dir=$(dirname "$libpython_files")
 echo "lib_dir: $lib_dir"
 echo "include_dir: $include_dir"
 
-g++ -fPIC -shared juliacall.cpp -o libjuliacall.dll -I. -I./include -I$include_dir -L$lib_dir -lpython3
+# frame pointers let `perf record -g` unwind through the entry points into Julia JIT code
+g++ -fPIC -shared -fno-omit-frame-pointer juliacall.cpp -o libjuliacall.dll -I. -I./include -I$include_dir -L$lib_dir -lpython3
 cp libjuliacall.dll ../tyjuliasetup/src/libjuliacall.dll
 
@@ -0,0 +1,72 @@
+#ifndef JULIACALL_BOXCACHE_H
+#define JULIACALL_BOXCACHE_H
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <unordered_map>
+#include <tyjuliacapi.hpp>
+#include <common.hpp>
+
+// Optional identity cache of `box_julia`, see `enable_box_cache` in tyjuliasetup/__init__.py:
+// a mutable Julia object boxed while a JV wrapping it is alive gives that same JV.
+// The cache does not own the JVs, each one removes itself when its capsule is destructed.
+
+// the address of a mutable Julia object, 0 for immutable values
+typedef uint64_t (*t_jlboxidentity)(JV jv);
+static t_jlboxidentity box_identity = NULL;
+static std::unordered_map<uint64_t, PyObject *> box_cache;
+
+// payload of the `__jlslot__` capsule
+struct t_JVSlot
+{
+    JV jv;
+    // key in `box_cache`, 0 if not cached
+    uint64_t identity;
+    // the JV holding the capsule, borrowed
+    PyObject *owner;
+    // `hash` of a value of an immutable type, computed at most once
+    bool8_t hash_cached;
+    int64_t hash;
+    // calls return JVs without conversion, see `no_convert` in tyjuliasetup/__init__.py
+    bool8_t raw;
+};
+
+static inline uint64_t BoxCache_Identity(JV jv)
+{
+    return box_identity == NULL ? 0 : box_identity(jv);
+}
+
+// a new reference to the live JV cached for `identity`, or NULL
+static PyObject *BoxCache_Get(uint64_t identity)
+{
+    if (identity == 0)
+        return NULL;
+    auto it = box_cache.find(identity);
+    if (it == box_cache.end() || Py_REFCNT(it->second) <= 0)
+        return NULL;
+    Py_INCREF(it->second);
+    return it->second;
+}
+
+static void BoxCache_Put(t_JVSlot *slot)
+{
+    if (slot->identity != 0)
+        box_cache[slot->identity] = slot->owner;
+}
+
+static void BoxCache_Remove(const t_JVSlot *slot)
+{
+    if (slot->identity == 0)
+        return;
+    auto it = box_cache.find(slot->identity);
+    if (it != box_cache.end() && it->second == slot->owner)
+        box_cache.erase(it);
+}
+
+static void BoxCache_Set(t_jlboxidentity identity)
+{
+    box_identity = identity;
+    box_cache.clear();
+}
+
+#endif
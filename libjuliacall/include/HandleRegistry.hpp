@@ -0,0 +1,152 @@
+#ifndef JULIACALL_HANDLEREGISTRY_H
+#define JULIACALL_HANDLEREGISTRY_H
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <unordered_map>
+#include <tyjuliacapi.hpp>
+#include <common.hpp>
+
+// JV handles owned by Python objects, from `box_julia` to `PyCapsule_Destruct_JuliaAsPython`,
+// see `start_handle_tracking` in tyjuliasetup/__init__.py.
+// The live count is always kept; while tracking is on, every handle boxed is
+// also recorded with its Julia type and, in debug mode, its allocation site.
+
+static int64_t jv_live_count = 0;
+
+struct t_HandleRecord
+{
+    // numbers the handles boxed while tracking, a JV is reused after being freed
+    uint64_t serial;
+    int64_t type_slot;
+    // result of `handle_site_capture()`, or NULL
+    PyObject *site;
+};
+
+static bool handle_tracking = false;
+static uint64_t handle_serial = 0;
+static PyObject *handle_site_capture = NULL;
+static std::unordered_map<JV, t_HandleRecord> handle_registry;
+
+static void HandleRegistry_Add(JV jv)
+{
+    jv_live_count++;
+    if (!handle_tracking)
+        return;
+    PyObject *site = NULL;
+    if (handle_site_capture != NULL)
+    {
+        PyObject *type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        site = PyObject_CallObject(handle_site_capture, NULL);
+        PyErr_Clear();
+        PyErr_Restore(type, value, traceback);
+    }
+    t_HandleRecord record = {++handle_serial, JLTypeOfAsTypeSlot(jv), site};
+    auto it = handle_registry.find(jv);
+    if (it != handle_registry.end())
+    {
+        Py_XDECREF(it->second.site);
+        it->second = record;
+    }
+    else
+    {
+        handle_registry.emplace(jv, record);
+    }
+}
+
+static void HandleRegistry_Remove(JV jv)
+{
+    jv_live_count--;
+    if (handle_registry.empty())
+        return;
+    auto it = handle_registry.find(jv);
+    if (it == handle_registry.end())
+        return;
+    Py_XDECREF(it->second.site);
+    handle_registry.erase(it);
+}
+
+static void HandleRegistry_Clear()
+{
+    for (auto &entry : handle_registry)
+        Py_XDECREF(entry.second.site);
+    handle_registry.clear();
+}
+
+// capture == None records no allocation sites
+static void HandleRegistry_SetTracking(bool on, PyObject *capture)
+{
+    HandleRegistry_Clear();
+    Py_XDECREF(handle_site_capture);
+    handle_site_capture = NULL;
+    handle_tracking = on;
+    if (on && capture != Py_None)
+    {
+        Py_INCREF(capture);
+        handle_site_capture = capture;
+    }
+}
+
+static PyObject *HandleRegistry_TypeName(int64_t slot)
+{
+    JV type;
+    if (JLTypeFromIdent(&type, slot) != ErrorCode::ok)
+        return NULL;
+    JV jrepr;
+    ErrorCode ret = JLCall(&jrepr, MyJLAPI.f_repr, SList_adapt(&type, 1), emptyKwArgs());
+    JLFreeFromMe(type);
+    if (ret != ErrorCode::ok)
+        return NULL;
+    PyObject *name = pycast2py(jrepr);
+    JLFreeFromMe(jrepr);
+    return name;
+}
+
+// [(serial, type name, site)] of the handles recorded while tracking and still alive
+static PyObject *HandleRegistry_Snapshot()
+{
+    PyObject *names = PyDict_New();
+    PyObject *records = PyList_New(0);
+    if (names == NULL || records == NULL)
+    {
+        Py_XDECREF(names);
+        Py_XDECREF(records);
+        return NULL;
+    }
+    for (auto &entry : handle_registry)
+    {
+        const t_HandleRecord &record = entry.second;
+        PyObject *slot = PyLong_FromLongLong(record.type_slot);
+        PyObject *name = slot == NULL ? NULL : PyDict_GetItem(names, slot);
+        if (name == NULL && slot != NULL)
+        {
+            name = HandleRegistry_TypeName(record.type_slot);
+            if (name == NULL)
+            {
+                ClearJLError();
+                PyErr_Clear();
+                name = PyUnicode_FromString("?");
+            }
+            if (name != NULL)
+            {
+                PyDict_SetItem(names, slot, name);
+                Py_DecRef(name);
+            }
+        }
+        Py_XDECREF(slot);
+        PyObject *item = name == NULL ? NULL : Py_BuildValue("(KOO)", (unsigned long long)record.serial, name, record.site == NULL ? Py_None : record.site);
+        if (item == NULL || PyList_Append(records, item) != 0)
+        {
+            Py_XDECREF(item);
+            Py_DecRef(names);
+            Py_DecRef(records);
+            return NULL;
+        }
+        Py_DecRef(item);
+    }
+    Py_DecRef(names);
+    return records;
+}
+
+#endif
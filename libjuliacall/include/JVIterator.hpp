@@ -0,0 +1,218 @@
+#ifndef JULIACALL_JVITERATOR_H
+#define JULIACALL_JVITERATOR_H
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <tyjuliacapi.hpp>
+#include <common.hpp>
+#include <TyPython.hpp>
+#include <Stats.hpp>
+
+// number of elements fetched from Julia per boundary crossing
+#define JV_ITER_CHUNK_SIZE 256
+// isbits elements are copied as a numpy array, so larger chunks are cheap
+#define JV_ITER_ISBITS_CHUNK_SIZE 4096
+
+// keep in sync with `chunked_iterator` in tyjuliasetup/src/containers.jl
+enum struct IterKind : int64_t
+{
+    elements = 0,
+    keys = 1,
+    values = 2,
+    items = 3,
+    reversed = 4
+};
+
+struct JVIteratorObject
+{
+    PyObject_HEAD
+    JV stateful;     // Iterators.Stateful, IsbitsChunks or Stepwise owned by this iterator
+    bool8_t isbits;  // elements are fetched as a numpy array
+    int64_t chunk_size; // 1 for a Stepwise iterator, which must not be read ahead
+    bool8_t exhausted;
+    JV error;        // Julia exception raised once the elements fetched before it are consumed
+    PyObject *chunk; // list of boxed elements of the current chunk
+    Py_ssize_t head;
+};
+
+static int JVIterator_fill_isbits(JVIteratorObject *it)
+{
+    JV jv_n;
+    ToJLInt64(&jv_n, JV_ITER_ISBITS_CHUNK_SIZE);
+    JV jchunk;
+    JV jargs[2] = {it->stateful, jv_n};
+    ErrorCode ret = JLCall(&jchunk, MyJLAPI.f_next_isbits_chunk, SList_adapt(jargs, 2), emptyKwArgs());
+    JLFreeFromMe(jv_n);
+    if (ret != ErrorCode::ok)
+    {
+        HandleJLErrorAndReturnNULL();
+        return -1;
+    }
+
+    PyObject *arr = pycast2py(jchunk);
+    if (arr == NULL)
+    {
+        JLFreeFromMe(jchunk);
+        PyErr_SetString(JuliaCallError, "iterate: failed to convert elements to a numpy array.");
+        return -1;
+    }
+    // ndarray.tolist gives the same Python scalars as reasonable_box;
+    // the array may share memory with the Julia vector, so free it after copying
+    it->chunk = PyObject_CallMethod(arr, "tolist", NULL);
+    Py_DecRef(arr);
+    JLFreeFromMe(jchunk);
+    if (it->chunk == NULL)
+        return -1;
+
+    if (PyList_Size(it->chunk) < JV_ITER_ISBITS_CHUNK_SIZE)
+        it->exhausted = true;
+    return 0;
+}
+
+static int JVIterator_fill(JVIteratorObject *it)
+{
+    // every chunk is a crossing of its own, counted like the `__jl_iter__` that started it
+    EntryStatsScope stats(EntryPoint::iter);
+    stats.enter(StatsPhase::call);
+    if (it->error != JV_NULL)
+    {
+        JV error = it->error;
+        it->error = JV_NULL;
+        it->exhausted = true;
+        RaiseJLExceptionAndReturnNULL(error);
+        return -1;
+    }
+    if (it->isbits)
+        return JVIterator_fill_isbits(it);
+
+    // one crossing for the whole chunk, then box the handles on the Python side
+    JV handles[JV_ITER_CHUNK_SIZE];
+    int64_t n = 0;
+    JV error = JV_NULL;
+    ErrorCode ret = jliteratechunk(handles, it->chunk_size, it->stateful, &n, &error);
+    if (ret != ErrorCode::ok)
+    {
+        if (n == 0)
+        {
+            it->exhausted = true;
+            if (error == JV_NULL)
+            {
+                PyErr_SetString(JuliaCallError, "iterate: failed to fetch elements from Julia.");
+                return -1;
+            }
+            RaiseJLExceptionAndReturnNULL(error);
+            return -1;
+        }
+        // hand out the elements fetched so far, the next fill raises the error
+        it->error = error;
+    }
+    else if (n < it->chunk_size)
+        it->exhausted = true;
+
+    stats.enter(StatsPhase::box);
+
+    it->chunk = PyList_New(n);
+    if (it->chunk == NULL)
+    {
+        for (int64_t i = 0; i < n; i++)
+            JLFreeFromMe(handles[i]);
+        return -1;
+    }
+
+    for (int64_t i = 0; i < n; i++)
+    {
+        PyObject *py = reasonable_box(handles[i]);
+        if (py == NULL)
+        {
+            for (int64_t j = i; j < n; j++)
+                JLFreeFromMe(handles[j]);
+            Py_DecRef(it->chunk);
+            it->chunk = NULL;
+            return -1;
+        }
+        if (!PyCheck_JV(py))
+        {
+            // if py is a JV object, we should not free it from Julia.
+            JLFreeFromMe(handles[i]);
+        }
+        PyList_SetItem(it->chunk, i, py);
+    }
+    return 0;
+}
+
+static PyObject *JVIterator_next(PyObject *self)
+{
+    JVIteratorObject *it = (JVIteratorObject *)self;
+    if (it->chunk == NULL || it->head == PyList_Size(it->chunk))
+    {
+        Py_XDECREF(it->chunk);
+        it->chunk = NULL;
+        it->head = 0;
+        if (it->exhausted)
+            return NULL;
+        if (JVIterator_fill(it) != 0)
+            return NULL;
+        if (PyList_Size(it->chunk) == 0)
+            return NULL;
+    }
+    PyObject *item = PyList_GetItem(it->chunk, it->head++);
+    Py_IncRef(item);
+    return item;
+}
+
+static void JVIterator_dealloc(PyObject *self)
+{
+    JVIteratorObject *it = (JVIteratorObject *)self;
+    PyTypeObject *tp = Py_TYPE(self);
+    Py_XDECREF(it->chunk);
+    ReleaseQueue_Push(it->stateful);
+    if (it->error != JV_NULL)
+        ReleaseQueue_Push(it->error);
+    PyObject_Free(self);
+#if PY_VERSION_HEX >= 0x03080000
+    // instances of heap types own a reference to their type since 3.8
+    Py_DecRef((PyObject *)tp);
+#else
+    (void)tp;
+#endif
+}
+
+static PyType_Slot JVIterator_slots[] = {
+    {Py_tp_dealloc, (void *)JVIterator_dealloc},
+    {Py_tp_iter, (void *)PyObject_SelfIter},
+    {Py_tp_iternext, (void *)JVIterator_next},
+    {0, NULL}};
+
+static PyType_Spec JVIterator_spec = {
+    "_tyjuliacall_jnumpy.JVIterator",
+    sizeof(JVIteratorObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    JVIterator_slots};
+
+static int init_JVIterator()
+{
+    MyPyAPI.t_JVIterator = PyType_FromSpec(&JVIterator_spec);
+    return MyPyAPI.t_JVIterator == NULL ? -1 : 0;
+}
+
+// takes the ownership of `stateful`
+static PyObject *JVIterator_New(JV stateful)
+{
+    JVIteratorObject *it = PyObject_New(JVIteratorObject, (PyTypeObject *)MyPyAPI.t_JVIterator);
+    if (it == NULL)
+    {
+        JLFreeFromMe(stateful);
+        return NULL;
+    }
+    it->stateful = stateful;
+    it->isbits = JLIsInstanceWithTypeSlot(stateful, MyJLAPI.t_IsbitsChunks);
+    it->chunk_size = JLIsInstanceWithTypeSlot(stateful, MyJLAPI.t_Stepwise) ? 1 : JV_ITER_CHUNK_SIZE;
+    it->exhausted = false;
+    it->error = JV_NULL;
+    it->chunk = NULL;
+    it->head = 0;
+    return (PyObject *)it;
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef JULIACALL_RELEASEQUEUE_H
+#define JULIACALL_RELEASEQUEUE_H
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdlib.h>
+#include <tyjuliacapi.hpp>
+#include <common.hpp>
+
+// Handles released by Python finalizers are not freed at once: they are queued
+// and freed in one crossing into Julia at the next entry point, or by the
+// finalizer that fills a batch if its thread has called into Julia before.
+// A finalizer may run on a thread Julia has never seen, which must not call Julia.
+// Finalizers and entry points run with the GIL held, which guards the queue.
+
+#define JV_RELEASE_BATCH 4096
+
+static JV *release_queue = NULL;
+static int64_t release_size = 0;
+static int64_t release_capacity = 0;
+// set on the threads that have entered libjuliacall
+static thread_local bool release_thread_entered = false;
+
+static void ReleaseQueue_Drain()
+{
+    while (release_size != 0)
+    {
+        // handles released while freeing go to a new batch
+        JV *batch = release_queue;
+        int64_t n = release_size;
+        release_queue = NULL;
+        release_size = 0;
+        release_capacity = 0;
+        jlfreehandles((void *)_fptr_JLFreeFromMe, batch, n);
+        free(batch);
+    }
+}
+
+static inline void ReleaseQueue_Enter()
+{
+    release_thread_entered = true;
+    if (release_size != 0)
+        ReleaseQueue_Drain();
+}
+
+static void ReleaseQueue_Push(JV jv)
+{
+    if (release_size == release_capacity)
+    {
+        int64_t capacity = release_capacity == 0 ? JV_RELEASE_BATCH : 2 * release_capacity;
+        JV *queue = (JV *)realloc(release_queue, capacity * sizeof(JV));
+        if (queue == NULL)
+        {
+            // no memory to defer it, free it now
+            JLFreeFromMe(jv);
+            return;
+        }
+        release_queue = queue;
+        release_capacity = capacity;
+    }
+    release_queue[release_size++] = jv;
+    if (release_size >= JV_RELEASE_BATCH && release_thread_entered)
+        ReleaseQueue_Drain();
+}
+
+#endif
@@ -0,0 +1,451 @@
+#ifndef JULIACALL_STATS_H
+#define JULIACALL_STATS_H
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <chrono>
+#include <string.h>
+#include <tyjuliacapi.hpp>
+#include <common.hpp>
+#include <TyPython.hpp>
+#include <Trace.hpp>
+
+// keep in sync with `ENTRY_POINT_NAMES`
+enum struct EntryPoint : int
+{
+    eval,
+    display,
+    repr_pretty,
+    call,
+    getattr,
+    setattr,
+    hasattr,
+    getitem,
+    setitem,
+    add,
+    sub,
+    mul,
+    matmul,
+    truediv,
+    floordiv,
+    mod,
+    pow,
+    lshift,
+    rshift,
+    bitor_,
+    bitxor,
+    bitand_,
+    eq,
+    ne,
+    lt,
+    le,
+    gt,
+    ge,
+    contains,
+    invert,
+    pos,
+    neg,
+    abs,
+    bool_,
+    hash,
+    len,
+    mapping_getitem,
+    mapping_contains,
+    iter,
+    n
+};
+
+static const char *ENTRY_POINT_NAMES[] = {
+    "eval", "display", "repr_pretty", "call", "getattr", "setattr", "hasattr", "getitem", "setitem",
+    "add", "sub", "mul", "matmul", "truediv", "floordiv", "mod", "pow", "lshift", "rshift",
+    "bitor", "bitxor", "bitand", "eq", "ne", "lt", "le", "gt", "ge", "contains",
+    "invert", "pos", "neg", "abs", "bool", "hash", "len", "mapping_getitem", "mapping_contains", "iter"};
+static_assert(sizeof(ENTRY_POINT_NAMES) / sizeof(ENTRY_POINT_NAMES[0]) == (size_t)EntryPoint::n,
+              "ENTRY_POINT_NAMES is out of sync with EntryPoint");
+
+// unbox: argument checks and Python -> Julia conversion,
+// call: the Julia side, box: Julia -> Python conversion
+enum struct StatsPhase : int
+{
+    unbox,
+    call,
+    box,
+    n
+};
+
+static const char *STATS_PHASE_NAMES[] = {"unbox", "call", "box"};
+
+// bucket i counts latencies in [2^i, 2^(i+1)) ns, the last one everything above
+#define STATS_HISTOGRAM_BUCKETS 32
+
+struct t_PhaseStats
+{
+    uint64_t total_ns;
+    uint64_t buckets[STATS_HISTOGRAM_BUCKETS];
+};
+
+// Julia allocation and GC accounting of the call phase, see `start_gc_accounting`
+// in tyjuliasetup/__init__.py; keep in sync with `gc_snapshot` in tyjuliasetup/src/tracing.jl
+enum struct GCCounter : int
+{
+    bytes,
+    allocs,
+    gc_ns,
+    gc_pauses,
+    n
+};
+
+static const char *GC_COUNTER_NAMES[] = {"bytes", "allocs", "gc_ns", "gc_pauses"};
+
+// writes the current value of each GCCounter to `out`
+typedef void (*t_jlgcsnapshot)(int64_t *out);
+static t_jlgcsnapshot gc_snapshot = NULL;
+// store the counters of `call` on the returned JV objects
+static bool gc_annotate = false;
+
+struct t_EntryStats
+{
+    uint64_t count;
+    uint64_t errors;
+    t_PhaseStats phases[(int)StatsPhase::n];
+    int64_t julia[(int)GCCounter::n];
+};
+
+static t_EntryStats entry_stats[(int)EntryPoint::n];
+
+static inline uint64_t stats_now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static inline void stats_record(t_PhaseStats *phase, uint64_t ns)
+{
+    int bucket = 0;
+    for (uint64_t x = ns >> 1; x != 0 && bucket < STATS_HISTOGRAM_BUCKETS - 1; x >>= 1)
+        bucket++;
+    phase->total_ns += ns;
+    phase->buckets[bucket]++;
+}
+
+// call-site sampling, see `start_sampling` in tyjuliasetup/__init__.py:
+// every `sample_every`-th crossing is reported to `sample_sink` as
+// `sink(entry, julia, filename, lineno, wall_ns, conversion_bytes, julia_bytes)`
+static uint64_t sample_every = 0;
+static uint64_t sample_countdown = 0;
+static PyObject *sample_sink = NULL;
+// frames from files under these prefixes (the JV wrappers) are not call sites
+static PyObject *sample_skip_prefixes = NULL;
+
+static bool stats_should_sample()
+{
+    if (sample_every == 0 || --sample_countdown != 0)
+        return false;
+    sample_countdown = sample_every;
+    return true;
+}
+
+// the innermost Python frame outside of `sample_skip_prefixes`, as new references
+static void sample_call_site(PyObject **filename, PyObject **lineno)
+{
+    PyObject *frame = (PyObject *)PyEval_GetFrame();
+    Py_XINCREF(frame);
+    while (frame != NULL && frame != Py_None)
+    {
+        PyObject *code = PyObject_GetAttrString(frame, "f_code");
+        PyObject *file = code == NULL ? NULL : PyObject_GetAttrString(code, "co_filename");
+        Py_XDECREF(code);
+        if (file == NULL)
+            break;
+        bool skip = false;
+        Py_ssize_t n = PyTuple_Size(sample_skip_prefixes);
+        for (Py_ssize_t i = 0; i < n && !skip; i++)
+        {
+            skip = PyUnicode_Tailmatch(file, PyTuple_GetItem(sample_skip_prefixes, i), 0, PY_SSIZE_T_MAX, -1) == 1;
+        }
+        if (!skip)
+        {
+            *filename = file;
+            *lineno = PyObject_GetAttrString(frame, "f_lineno");
+            Py_DecRef(frame);
+            return;
+        }
+        Py_DecRef(file);
+        PyObject *back = PyObject_GetAttrString(frame, "f_back");
+        Py_DecRef(frame);
+        frame = back;
+    }
+    Py_XDECREF(frame);
+    PyErr_Clear();
+}
+
+static PyObject *sample_julia_name(JV callee, const char *attr)
+{
+    if (attr != NULL)
+        return PyUnicode_FromString(attr);
+    if (callee == JV_NULL)
+    {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    JV jrepr;
+    if (JLCall(&jrepr, MyJLAPI.f_repr, SList_adapt(&callee, 1), emptyKwArgs()) != ErrorCode::ok)
+    {
+        // do not leave the error of `repr` to the next HandleJLErrorAndReturnNULL
+        ClearJLError();
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    PyObject *name = pycast2py(jrepr);
+    JLFreeFromMe(jrepr);
+    return name;
+}
+
+// reports one sampled crossing, keeping any pending exception of the entry point
+static void stats_report_sample(EntryPoint ep, JV callee, const char *attr, uint64_t wall_ns, int64_t conversion_bytes, int64_t julia_bytes)
+{
+    PyObject *type, *value, *traceback;
+    PyErr_Fetch(&type, &value, &traceback);
+
+    PyObject *filename = NULL, *lineno = NULL;
+    sample_call_site(&filename, &lineno);
+    PyObject *julia = sample_julia_name(callee, attr);
+    PyObject *args = Py_BuildValue(
+        "(sOOOKLL)", ENTRY_POINT_NAMES[(int)ep],
+        julia == NULL ? Py_None : julia,
+        filename == NULL ? Py_None : filename,
+        lineno == NULL ? Py_None : lineno,
+        (unsigned long long)wall_ns, (long long)conversion_bytes, (long long)julia_bytes);
+    if (args != NULL && sample_sink != NULL)
+    {
+        PyObject *ret = PyObject_CallObject(sample_sink, args);
+        Py_XDECREF(ret);
+    }
+    Py_XDECREF(args);
+    Py_XDECREF(julia);
+    Py_XDECREF(filename);
+    Py_XDECREF(lineno);
+
+    // sampling never changes the outcome of the sampled call
+    PyErr_Clear();
+    PyErr_Restore(type, value, traceback);
+}
+
+// times one invocation of an entry point: starts in the unbox phase, `enter`
+// moves to the next phase, and the destructor closes the current phase and
+// counts an error if the entry point leaves with a Python exception set
+struct EntryStatsScope
+{
+    t_EntryStats *stats;
+    EntryPoint ep;
+    StatsPhase phase;
+    uint64_t t0;
+
+    // only for sampled crossings: the called Julia object or attribute name,
+    // and the Julia bytes allocated while converting (unbox and box phases)
+    bool sampled;
+    JV callee = JV_NULL;
+    const char *attr = NULL;
+    uint64_t start_ns;
+    int64_t start_bytes;
+    int64_t phase_bytes;
+    int64_t conversion_bytes = 0;
+
+    // only while tracing: the event being filled and the Julia clocks at entry
+    t_TraceEvent trace;
+    bool traced;
+    uint64_t gc_start_ns;
+    uint64_t compile_start_ns;
+
+    // only while accounting: the counters at the start of the call phase, then their deltas
+    bool accounted = false;
+    int64_t julia[(int)GCCounter::n];
+
+    EntryStatsScope(EntryPoint ep) : stats(&entry_stats[(int)ep]), ep(ep), phase(StatsPhase::unbox), t0(stats_now_ns())
+    {
+        // every entry point is a safe point to free the handles released since the last one
+        ReleaseQueue_Enter();
+        stats->count++;
+        sampled = stats_should_sample();
+        if (sampled)
+        {
+            start_ns = t0;
+            start_bytes = phase_bytes = jlgctotalbytes();
+        }
+        traced = trace_enabled();
+        if (traced)
+        {
+            trace = t_TraceEvent{(int32_t)ep, trace_depth++, (uint64_t)PyThread_get_thread_ident(), t0, 0, 0, 0, 0, 0};
+            gc_start_ns = trace_clock(trace_gc_clock);
+            compile_start_ns = trace_clock(trace_compile_clock);
+        }
+    }
+
+    void enter(StatsPhase next)
+    {
+        uint64_t t = stats_now_ns();
+        stats_record(&stats->phases[(int)phase], t - t0);
+        if (sampled)
+            sample_phase_bytes();
+        if (traced)
+            (next == StatsPhase::call ? trace.call_ns : trace.box_ns) = t;
+        if (phase == StatsPhase::call)
+            account_call_end();
+        phase = next;
+        t0 = t;
+        if (next == StatsPhase::call && gc_snapshot != NULL)
+        {
+            accounted = true;
+            gc_snapshot(julia);
+        }
+    }
+
+    void account_call_end()
+    {
+        if (!accounted)
+            return;
+        int64_t now[(int)GCCounter::n];
+        gc_snapshot(now);
+        for (int i = 0; i < (int)GCCounter::n; i++)
+        {
+            julia[i] = now[i] - julia[i];
+            stats->julia[i] += julia[i];
+        }
+    }
+
+    // attaches the counters of the call to `result` if it is a JV
+    void annotate(PyObject *result)
+    {
+        if (!accounted || !gc_annotate || result == NULL || !PyCheck_JV(result))
+            return;
+        PyObject *counters = Py_BuildValue(
+            "(LLLL)", (long long)julia[0], (long long)julia[1], (long long)julia[2], (long long)julia[3]);
+        if (counters == NULL || PyObject_GenericSetAttr(result, name_jlalloc, counters) != 0)
+            PyErr_Clear();
+        Py_XDECREF(counters);
+    }
+
+    void sample_phase_bytes()
+    {
+        int64_t bytes = jlgctotalbytes();
+        if (phase != StatsPhase::call)
+            conversion_bytes += bytes - phase_bytes;
+        phase_bytes = bytes;
+    }
+
+    ~EntryStatsScope()
+    {
+        uint64_t t = stats_now_ns();
+        stats_record(&stats->phases[(int)phase], t - t0);
+        if (phase == StatsPhase::call)
+            account_call_end();
+        if (PyErr_Occurred() != NULL)
+            stats->errors++;
+        if (sampled)
+        {
+            sample_phase_bytes();
+            stats_report_sample(ep, callee, attr, t - start_ns, conversion_bytes, phase_bytes - start_bytes);
+        }
+        // the tracer may have been stopped by a Python callback during the call
+        if (traced && trace_enabled())
+        {
+            trace_depth--;
+            trace.end_ns = t;
+            trace.gc_ns = trace_clock(trace_gc_clock) - gc_start_ns;
+            trace.compile_ns = trace_clock(trace_compile_clock) - compile_start_ns;
+            *trace_claim() = trace;
+        }
+    }
+};
+
+static PyObject *PhaseStats_ToPy(const t_PhaseStats *phase)
+{
+    PyObject *histogram = PyList_New(STATS_HISTOGRAM_BUCKETS);
+    if (histogram == NULL)
+        return NULL;
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++)
+    {
+        PyList_SetItem(histogram, i, PyLong_FromUnsignedLongLong(phase->buckets[i]));
+    }
+    return Py_BuildValue("{s:K,s:N}", "total_ns", (unsigned long long)phase->total_ns, "histogram", histogram);
+}
+
+// {entry point: {"count", "errors", "unbox"/"call"/"box": {"total_ns", "histogram"},
+//                "julia": {"bytes", "allocs", "gc_ns", "gc_pauses"}}}
+// for the entry points called since the last reset
+static PyObject *EntryStats_ToPy()
+{
+    PyObject *result = PyDict_New();
+    if (result == NULL)
+        return NULL;
+    for (int i = 0; i < (int)EntryPoint::n; i++)
+    {
+        const t_EntryStats *stats = &entry_stats[i];
+        if (stats->count == 0)
+            continue;
+        const int64_t *julia = stats->julia;
+        PyObject *entry = Py_BuildValue(
+            "{s:K,s:K,s:{s:L,s:L,s:L,s:L}}", "count", (unsigned long long)stats->count, "errors", (unsigned long long)stats->errors,
+            "julia", GC_COUNTER_NAMES[0], (long long)julia[0], GC_COUNTER_NAMES[1], (long long)julia[1],
+            GC_COUNTER_NAMES[2], (long long)julia[2], GC_COUNTER_NAMES[3], (long long)julia[3]);
+        if (entry == NULL)
+        {
+            Py_DecRef(result);
+            return NULL;
+        }
+        for (int p = 0; p < (int)StatsPhase::n; p++)
+        {
+            PyObject *phase = PhaseStats_ToPy(&stats->phases[p]);
+            if (phase == NULL || PyDict_SetItemString(entry, STATS_PHASE_NAMES[p], phase) != 0)
+            {
+                Py_XDECREF(phase);
+                Py_DecRef(entry);
+                Py_DecRef(result);
+                return NULL;
+            }
+            Py_DecRef(phase);
+        }
+        if (PyDict_SetItemString(result, ENTRY_POINT_NAMES[i], entry) != 0)
+        {
+            Py_DecRef(entry);
+            Py_DecRef(result);
+            return NULL;
+        }
+        Py_DecRef(entry);
+    }
+    return result;
+}
+
+static void EntryStats_Reset()
+{
+    memset(entry_stats, 0, sizeof(entry_stats));
+}
+
+// sink == None turns sampling off
+static PyObject *EntryStats_SetSampling(unsigned long long every, PyObject *sink, PyObject *skip_prefixes)
+{
+    if (sink != Py_None && !PyTuple_Check(skip_prefixes))
+    {
+        PyErr_SetString(PyExc_TypeError, "skip_prefixes must be a tuple of str");
+        return NULL;
+    }
+    Py_XDECREF(sample_sink);
+    Py_XDECREF(sample_skip_prefixes);
+    sample_sink = NULL;
+    sample_skip_prefixes = NULL;
+    sample_every = 0;
+    if (sink != Py_None && every != 0)
+    {
+        Py_INCREF(sink);
+        Py_INCREF(skip_prefixes);
+        sample_sink = sink;
+        sample_skip_prefixes = skip_prefixes;
+        sample_every = every;
+        sample_countdown = every;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+#endif
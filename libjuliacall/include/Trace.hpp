@@ -0,0 +1,110 @@
+#ifndef JULIACALL_TRACE_H
+#define JULIACALL_TRACE_H
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <atomic>
+#include <stdlib.h>
+
+// Timeline tracing of the entry points, see `start_trace` in tyjuliasetup/__init__.py.
+// Each traced call writes one fixed-size event into a ring buffer; the oldest
+// events are overwritten when it is full. Slots are claimed with an atomic
+// counter, so writers never take a lock.
+
+// clocks of the Julia runtime: cumulative GC and compilation time in ns
+typedef uint64_t (*t_jlclock)(void);
+
+struct t_TraceEvent
+{
+    int32_t entry;
+    // number of traced calls this one is nested in, e.g. Julia calling back into Python
+    int32_t depth;
+    uint64_t tid;
+    // timestamps of the phase boundaries, 0 for the phases not reached
+    uint64_t start_ns;
+    uint64_t call_ns;
+    uint64_t box_ns;
+    uint64_t end_ns;
+    // Julia GC and compilation time observed during the call
+    uint64_t gc_ns;
+    uint64_t compile_ns;
+};
+
+static t_TraceEvent *trace_ring = NULL;
+static uint64_t trace_capacity = 0;
+static std::atomic<uint64_t> trace_head{0};
+static int32_t trace_depth = 0;
+static t_jlclock trace_gc_clock = NULL;
+static t_jlclock trace_compile_clock = NULL;
+
+static inline bool trace_enabled()
+{
+    return trace_ring != NULL;
+}
+
+static inline uint64_t trace_clock(t_jlclock clock)
+{
+    return clock == NULL ? 0 : clock();
+}
+
+static inline t_TraceEvent *trace_claim()
+{
+    uint64_t i = trace_head.fetch_add(1, std::memory_order_relaxed);
+    return &trace_ring[i % trace_capacity];
+}
+
+static void Trace_Stop()
+{
+    free(trace_ring);
+    trace_ring = NULL;
+    trace_capacity = 0;
+    trace_head.store(0);
+    trace_depth = 0;
+    trace_gc_clock = NULL;
+    trace_compile_clock = NULL;
+}
+
+static int Trace_Start(uint64_t capacity, t_jlclock gc_clock, t_jlclock compile_clock)
+{
+    Trace_Stop();
+    trace_ring = (t_TraceEvent *)calloc(capacity, sizeof(t_TraceEvent));
+    if (trace_ring == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    trace_capacity = capacity;
+    trace_gc_clock = gc_clock;
+    trace_compile_clock = compile_clock;
+    return 0;
+}
+
+// [(entry, depth, tid, start_ns, call_ns, box_ns, end_ns, gc_ns, compile_ns)] oldest first,
+// and empties the buffer
+static PyObject *Trace_Drain(const char **entry_names)
+{
+    if (!trace_enabled())
+        return PyList_New(0);
+    uint64_t head = trace_head.exchange(0);
+    uint64_t n = head < trace_capacity ? head : trace_capacity;
+    PyObject *events = PyList_New((Py_ssize_t)n);
+    if (events == NULL)
+        return NULL;
+    for (uint64_t k = 0; k < n; k++)
+    {
+        const t_TraceEvent *e = &trace_ring[(head - n + k) % trace_capacity];
+        PyObject *event = Py_BuildValue(
+            "(siKKKKKKK)", entry_names[e->entry], (int)e->depth, (unsigned long long)e->tid,
+            (unsigned long long)e->start_ns, (unsigned long long)e->call_ns, (unsigned long long)e->box_ns,
+            (unsigned long long)e->end_ns, (unsigned long long)e->gc_ns, (unsigned long long)e->compile_ns);
+        if (event == NULL)
+        {
+            Py_DecRef(events);
+            return NULL;
+        }
+        PyList_SetItem(events, (Py_ssize_t)k, event);
+    }
+    return events;
+}
+
+#endif
@@ -5,6 +5,9 @@
 #include <Python.h>
 #include <tyjuliacapi.hpp>
 #include <common.hpp>
+#include <HandleRegistry.hpp>
+#include <ReleaseQueue.hpp>
+#include <BoxCache.hpp>
 #include <assert.h>
 #include <stdlib.h>
 
@@ -22,15 +25,42 @@ static int PyCheck_Type_Exact(PyObject *py, PyObject *type)
     }
 }
 
+static int PyCheck_JV(PyObject *py)
+{
+    // NULL is a failed box, the caller still owns the handle
+    if (py == NULL)
+        return 0;
+    // JV and the container proxies deriving from it share the same layout
+    PyObject *type = (PyObject *)Py_TYPE(py);
+    return type == MyPyAPI.t_JV || type == MyPyAPI.t_JVMapping || type == MyPyAPI.t_JVSequence;
+}
+
+static PyObject *jv_class_of(JV jv)
+{
+    if (JLIsInstanceWithTypeSlot(jv, MyJLAPI.t_AbstractDict) ||
+        JLIsInstanceWithTypeSlot(jv, MyJLAPI.t_NamedTuple))
+        return MyPyAPI.t_JVMapping;
+
+    if (JLIsInstanceWithTypeSlot(jv, MyJLAPI.t_VectorAny))
+        return MyPyAPI.t_JVSequence;
+
+    return MyPyAPI.t_JV;
+}
+
 static void
 PyCapsule_Destruct_JuliaAsPython(PyObject *capsule)
 {
     // destruct of capsule(__jlslot__)
-    JV *jv = (JV *)PyCapsule_GetPointer(capsule, NULL);
-    JLFreeFromMe(*jv);
-    free(jv);
+    t_JVSlot *slot = (t_JVSlot *)PyCapsule_GetPointer(capsule, NULL);
+    BoxCache_Remove(slot);
+    HandleRegistry_Remove(slot->jv);
+    ReleaseQueue_Push(slot->jv);
+    free(slot);
 }
 
+// takes the ownership of `jv` if it returns a JV, the caller keeps it on failure
+static PyObject *box_julia_new(JV jv, uint64_t identity);
+
 static PyObject *box_julia(JV jv)
 {
     // JV(julia value) -> PyObject(python's JV with __jlslot__)
@@ -40,35 +70,69 @@ static PyObject *box_julia(JV jv)
         return NULL;
     }
 
-    JV *ptr_boxed = (JV *)malloc(sizeof(JV));
-    *ptr_boxed = jv;
-
-    PyObject *capsule = PyCapsule_New( // 把jv对象包装成一个python对象
-        ptr_boxed,
-        NULL,
-        &PyCapsule_Destruct_JuliaAsPython);
+    uint64_t identity = BoxCache_Identity(jv);
+    PyObject *cached = BoxCache_Get(identity);
+    if (cached != NULL)
+    {
+        // the cached JV has its own handle to the same object
+        JLFreeFromMe(jv);
+        return cached;
+    }
+    return box_julia_new(jv, identity);
+}
 
-    PyObject *pyjv = PyObject_CallObject(MyPyAPI.t_JV, NULL); // This is the equivalent of the Python expression:callable(arg1, arg2, ...)
+static PyObject *box_julia_new(JV jv, uint64_t identity)
+{
+    // a JV distinct from any other, cached for `identity` unless it is 0
+    PyObject *pyjv = PyObject_CallObject(jv_class_of(jv), NULL); // This is the equivalent of the Python expression:callable(arg1, arg2, ...)
     if (pyjv == NULL)
     {
         PyErr_SetString(PyExc_RuntimeError, "box_julia: failed to create a new instance of JV");
         return NULL;
     }
 
-    PyObject_GenericSetAttr(pyjv, name_jlslot, capsule);
+    t_JVSlot *slot = (t_JVSlot *)malloc(sizeof(t_JVSlot));
+    *slot = t_JVSlot{jv, identity, pyjv, false, 0, false};
+
+    PyObject *capsule = PyCapsule_New( // 把jv对象包装成一个python对象
+        slot,
+        NULL,
+        &PyCapsule_Destruct_JuliaAsPython);
+    if (capsule == NULL || PyObject_GenericSetAttr(pyjv, name_jlslot, capsule) != 0)
+    {
+        if (capsule != NULL)
+        {
+            // give the handle back to the caller
+            PyCapsule_SetDestructor(capsule, NULL);
+            Py_DecRef(capsule);
+        }
+        free(slot);
+        Py_DecRef(pyjv);
+        return NULL;
+    }
+    // the JV keeps the capsule, which owns the handle from here on
+    Py_DecRef(capsule);
+    HandleRegistry_Add(jv);
+    BoxCache_Put(slot);
     return pyjv;
 }
 
-static JV unbox_julia(PyObject *pyjv)
+static t_JVSlot *jv_slot_of(PyObject *pyjv)
 {
     // assume pyjv is a python's JV instance with __jlslot__
     //__jlslot__用于定义对象在转换为字符串时的自定义字符串表示。
     PyObject *capsule = PyObject_GetAttr(pyjv, name_jlslot);
     // 用于在一个 Python 对象 pyjv 上获取一个名为 name_jlslot 的属性,并返回该属性的值
-    JV *jv = (JV *)PyCapsule_GetPointer(capsule, NULL);
+    t_JVSlot *slot = (t_JVSlot *)PyCapsule_GetPointer(capsule, NULL);
     // 函数的作用是从 PyCapsule 对象 capsule 中提取底层的 C 指针，并将其强制类型转换为 (JV *) 类型的指针
+    // the JV keeps the capsule alive
     Py_DecRef(capsule);
-    return *jv;
+    return slot;
+}
+
+static JV unbox_julia(PyObject *pyjv)
+{
+    return jv_slot_of(pyjv)->jv;
 }
 
 void free_jv_list(JV *jv_list, bool8_t *jv_list_tobefree, int length)
@@ -121,8 +185,10 @@ ErrorCode ToJLTupleFromPy(JV *out, PyObject *py)
     JV *jv_list = (JV *)calloc(length, sizeof(JV));
     bool8_t *jv_tobefree = (bool8_t *)calloc(length, sizeof(bool8_t));
     ErrorCode ret = ToJListFromPyTuple(jv_list, jv_tobefree, py, length);
-
-    ret = JLCall(out, MyJLAPI.f_tuple, SList_adapt(jv_list, length), emptyKwArgs());
+    if (ret == ErrorCode::ok)
+    {
+        ret = JLCall(out, MyJLAPI.f_tuple, SList_adapt(jv_list, length), emptyKwArgs());
+    }
     free_jv_list(jv_list, jv_tobefree, length);
     return ret;
 }
@@ -225,50 +291,158 @@ ErrorCode ToJLStrArrayFromPy(JV *out, PyObject *py)
 
     Py_ssize_t len = PyObject_Length(py_flatten);
     JV strArry;
-    JLNew_StringVector(&strArry, len);
+    if (JLNew_StringVector(&strArry, len) != ErrorCode::ok)
+    {
+        Py_DecRef(py_flatten);
+        return ErrorCode::error;
+    }
     for (Py_ssize_t i = 0; i < len; i++)
     {
         PyObject *ind = PyLong_FromSsize_t(i);
         PyObject *element = PyObject_GetItem(py_flatten, ind);
-        Py_IncRef(element);
+        Py_DecRef(ind);
         if (element == NULL)
         {
             JLFreeFromMe(strArry);
-            Py_DecRef(element);
-            Py_DecRef(ind);
             Py_DecRef(py_flatten);
-
             return ErrorCode::error;
         }
         JV str;
-        if (ErrorCode::ok == ToJLStringFromPy(&str, element))
+        ErrorCode ret = ToJLStringFromPy(&str, element);
+        Py_DecRef(element);
+        if (ret == ErrorCode::ok)
         {
-            JLSetIndexI(strArry, i + 1, str);
+            // the vector keeps the string, the handle is ours to free
+            ret = JLSetIndexI(strArry, i + 1, str);
+            JLFreeFromMe(str);
         }
-        else
+        if (ret != ErrorCode::ok)
         {
             JLFreeFromMe(strArry);
-            Py_DecRef(element);
-            Py_DecRef(ind);
             Py_DecRef(py_flatten);
             return ErrorCode::error;
         }
-        Py_DecRef(element);
-        Py_DecRef(ind);
     }
 
     Py_DecRef(py_flatten);
 
     // reshape
     PyObject *shape = PyObject_GetAttrString(py, "shape");
+    if (shape == NULL)
+    {
+        JLFreeFromMe(strArry);
+        return ErrorCode::error;
+    }
     bool8_t needToBeFree = false;
     JV jv_shape = reasonable_unbox(shape, &needToBeFree);
+    Py_DecRef(shape);
+    if (jv_shape == JV_NULL)
+    {
+        JLFreeFromMe(strArry);
+        return ErrorCode::error;
+    }
     JV jv_arg[2] = {strArry, jv_shape};
 
     ErrorCode ret = JLCall(out, MyJLAPI.f_reshape, SList_adapt(jv_arg, 2), emptyKwArgs());
-    JLFreeFromMe(jv_shape);
+    if (needToBeFree)
+        JLFreeFromMe(jv_shape);
     JLFreeFromMe(strArry);
-    Py_DecRef(shape);
+    return ret;
+}
+
+ErrorCode ToJLBytesFromPy(JV *out, PyObject *py)
+{
+    // bytes are immutable, so Julia gets its own Vector{UInt8} copy
+    char *data;
+    Py_ssize_t len;
+    if (PyBytes_AsStringAndSize(py, &data, &len) != 0)
+        return ErrorCode::error;
+
+    int64_t dims[1] = {len};
+    if (ErrorCode::ok != JLNew_U8Array(out, SList_adapt(dims, 1)))
+        return ErrorCode::error;
+
+    uint8_t *ptr;
+    int64_t n;
+    if (ErrorCode::ok != JLGetArrayPointer(&ptr, &n, *out))
+    {
+        JLFreeFromMe(*out);
+        return ErrorCode::error;
+    }
+    memcpy(ptr, data, len);
+    return ErrorCode::ok;
+}
+
+ErrorCode ToJLByteArrayFromPy(JV *out, PyObject *py)
+{
+    // a memoryview export forbids resizing the bytearray while Julia wraps
+    // its memory; the Julia array keeps the memoryview alive
+    PyObject *view = PyMemoryView_FromObject(py);
+    if (view == NULL)
+        return ErrorCode::error;
+
+    JV jargs[3];
+    ToJLUInt64(&jargs[0], (uint64_t)(uintptr_t)view);
+    ToJLUInt64(&jargs[1], (uint64_t)(uintptr_t)PyByteArray_AsString(py));
+    ToJLInt64(&jargs[2], PyByteArray_Size(py));
+    ErrorCode ret = JLCall(out, MyJLAPI.f_wrap_pybuffer, SList_adapt(jargs, 3), emptyKwArgs());
+    for (int i = 0; i < 3; i++)
+        JLFreeFromMe(jargs[i]);
+    Py_DecRef(view);
+    if (ret != ErrorCode::ok)
+        ClearJLError();
+    return ret;
+}
+
+ErrorCode ToJLArrayFromPyBuffer(JV *out, PyObject *view)
+{
+    // numpy is already loaded; asarray only builds an ndarray view of the buffer,
+    // while read-only buffers are copied so that Julia cannot write into them
+    PyObject *readonly = PyObject_GetAttrString(view, "readonly");
+    if (readonly == NULL)
+        return ErrorCode::error;
+    int isreadonly = PyObject_IsTrue(readonly);
+    Py_DecRef(readonly);
+
+    PyObject *arr = PyObject_CallMethod(MyPyAPI.m_NumPy, isreadonly ? "array" : "asarray", "O", view);
+    if (arr == NULL)
+        return ErrorCode::error;
+
+    ErrorCode ret = pycast2jl(out, MyJLAPI.t_AbstractArray, arr);
+    Py_DecRef(arr);
+    return ret;
+}
+
+// numpy scalars keep their value right after the object header,
+// see PyDoubleScalarObject, PyDatetimeScalarObject, ... in numpy's arrayscalars.h
+struct NumPyScalarObject
+{
+    PyObject_HEAD
+    union
+    {
+        int64_t i;
+        double d;
+        complex_t c;
+    } obval;
+};
+
+static NumPyScalarCode numpy_scalar_code(PyObject *py)
+{
+    PyObject *type = (PyObject *)Py_TYPE(py);
+    for (int i = 0; i < MyPyAPI.n_numpy_scalar_types; i++)
+    {
+        if (MyPyAPI.numpy_scalar_types[i].type == type)
+            return MyPyAPI.numpy_scalar_types[i].code;
+    }
+    return NumPyScalarCode::unsupported;
+}
+
+ErrorCode ToJLNumPyScalarFromPy(JV *out, PyObject *py, NumPyScalarCode code)
+{
+    // one crossing that reads the C struct directly, no `item()` round trip
+    ErrorCode ret = jlboxnumpyscalar(out, code, &((NumPyScalarObject *)py)->obval);
+    if (ret != ErrorCode::ok)
+        PyErr_SetString(JuliaCallError, "unbox failed: cannot convert a numpy scalar to Julia object");
     return ret;
 }
 
@@ -277,7 +451,7 @@ JV reasonable_unbox(PyObject *py, bool8_t *needToBeFree)
     if (py == Py_None)
         return MyJLAPI.obj_nothing;
 
-    if (PyCheck_Type_Exact(py, MyPyAPI.t_JV))
+    if (PyCheck_JV(py))
         return unbox_julia(py);
 
     JV out;
@@ -316,6 +490,23 @@ JV reasonable_unbox(PyObject *py, bool8_t *needToBeFree)
         return out;
     }
 
+    NumPyScalarCode code = numpy_scalar_code(py);
+    if (code != NumPyScalarCode::unsupported)
+    {
+        *needToBeFree = true;
+        if (ErrorCode::ok == ToJLNumPyScalarFromPy(&out, py, code))
+            return out;
+        return JV_NULL;
+    }
+
+    if (PyCheck_Type_Exact(py, MyPyAPI.t_npstr))
+    {
+        *needToBeFree = true;
+        if (ErrorCode::ok == ToJLStringFromPy(&out, py))
+            return out;
+        return JV_NULL;
+    }
+
     if (PyCheck_Type_Exact(py, MyPyAPI.t_ndarray))
     {
         *needToBeFree = true;
@@ -366,10 +557,141 @@ JV reasonable_unbox(PyObject *py, bool8_t *needToBeFree)
         }
     }
 
+    if (PyCheck_Type_Exact(py, MyPyAPI.t_bytes) || PyCheck_Type_Exact(py, MyPyAPI.t_npbytes))
+    {
+        *needToBeFree = true;
+        if (ErrorCode::ok == ToJLBytesFromPy(&out, py))
+            return out;
+        return JV_NULL;
+    }
+
+    if (PyCheck_Type_Exact(py, MyPyAPI.t_bytearray))
+    {
+        *needToBeFree = true;
+        if (ErrorCode::ok == ToJLByteArrayFromPy(&out, py))
+            return out;
+        return JV_NULL;
+    }
+
+    // memoryview, array.array and any other object supporting the buffer protocol;
+    // other numpy scalars (e.g. longdouble) export buffers too but are not arrays
+    PyObject *view = NULL;
+    if (PyCheck_Type_Exact(py, MyPyAPI.t_memoryview))
+    {
+        Py_IncRef(py);
+        view = py;
+    }
+    else if (PyObject_IsInstance(py, MyPyAPI.t_npgeneric) != 1)
+    {
+        view = PyMemoryView_FromObject(py);
+    }
+    if (view != NULL)
+    {
+        *needToBeFree = true;
+        ErrorCode ret = ToJLArrayFromPyBuffer(&out, view);
+        Py_DecRef(view);
+        if (ret == ErrorCode::ok)
+            return out;
+        if (PyErr_Occurred() != NULL)
+            return JV_NULL;
+    }
+    else
+    {
+        PyErr_Clear();
+    }
+
     PyErr_SetString(JuliaCallError, "unbox failed: cannot convert a Python object to Julia object");
     return JV_NULL;
 }
 
+PyObject *reasonable_box(JV jv);
+
+// tuples up to this arity are unpacked without heap allocation
+#define JV_SMALL_TUPLE_SIZE 16
+
+static void free_unpacked_tuple(PyObject **pys, JV *jvs, int64_t from, int64_t n)
+{
+    for (int64_t i = from; i < n; i++)
+    {
+        if (pys[i] != NULL)
+            Py_DecRef(pys[i]);
+        else if (jvs[i] != JV_NULL)
+            JLFreeFromMe(jvs[i]);
+    }
+}
+
+static PyObject *box_tuple(JV jv)
+{
+    // one crossing gives the arity and all elements: isbits elements come
+    // back as Python objects, the others as handles to be boxed here
+    PyObject *small_pys[JV_SMALL_TUPLE_SIZE] = {NULL};
+    JV small_jvs[JV_SMALL_TUPLE_SIZE] = {JV_NULL};
+    PyObject **pys = small_pys;
+    JV *jvs = small_jvs;
+    int64_t cap = JV_SMALL_TUPLE_SIZE;
+    int64_t N = 0;
+    ErrorCode ret = jlunpacktuple(pys, jvs, cap, jv, &N);
+    if (ret == ErrorCode::ok && N > cap)
+    {
+        cap = N;
+        pys = (PyObject **)calloc(cap, sizeof(PyObject *));
+        jvs = (JV *)calloc(cap, sizeof(JV));
+        if (pys == NULL || jvs == NULL)
+        {
+            // nothing was unpacked into the small buffers: the tuple did not fit
+            free(pys);
+            free(jvs);
+            PyErr_NoMemory();
+            return NULL;
+        }
+        ret = jlunpacktuple(pys, jvs, cap, jv, &N);
+    }
+
+    PyObject *argtuple = NULL;
+    if (ret != ErrorCode::ok)
+    {
+        free_unpacked_tuple(pys, jvs, 0, N < cap ? N : cap);
+        PyErr_SetString(JuliaCallError, "reasonable_box: failed to unpack a Julia tuple.");
+    }
+    else if ((argtuple = PyTuple_New(N)) == NULL)
+    {
+        free_unpacked_tuple(pys, jvs, 0, N);
+        PyErr_NoMemory();
+    }
+    else
+    {
+        for (int64_t i = 0; i < N; i++)
+        {
+            PyObject *arg = pys[i];
+            if (arg == NULL)
+            {
+                // reasonable_box should always return a new reference
+                arg = reasonable_box(jvs[i]);
+                if (arg == NULL)
+                {
+                    // the tuple releases the elements boxed so far
+                    free_unpacked_tuple(pys, jvs, i, N);
+                    Py_DecRef(argtuple);
+                    argtuple = NULL;
+                    break;
+                }
+                if (!PyCheck_JV(arg))
+                {
+                    JLFreeFromMe(jvs[i]);
+                }
+            }
+            PyTuple_SetItem(argtuple, i, arg);
+        }
+    }
+
+    if (pys != small_pys)
+    {
+        free(pys);
+        free(jvs);
+    }
+    return argtuple;
+}
+
 PyObject *reasonable_box(JV jv)
 {
     PyObject *py;
@@ -439,36 +761,7 @@ PyObject *reasonable_box(JV jv)
 
     if (JLIsInstanceWithTypeSlot(jv, MyJLAPI.t_Tuple))
     {
-        JV jv_N;
-        ErrorCode ret0 = JLCall(&jv_N, MyJLAPI.f_length, SList_adapt(&jv, 1), emptyKwArgs());
-        if (ret0 != ErrorCode::ok)
-        {
-            return HandleJLErrorAndReturnNULL();
-        }
-
-        int64_t N;
-        JLGetInt64(&N, jv_N, true);
-        JLFreeFromMe(jv_N);
-        PyObject *argtuple = PyTuple_New(N);
-
-        for (int64_t i = 0; i < N; i++)
-        {
-            JV v;
-            ErrorCode ret1 = JLGetIndexI(&v, jv, i + 1);
-            if (ret1 != ErrorCode::ok)
-            {
-                return HandleJLErrorAndReturnNULL();
-            }
-            // reasonable_box should always return a new reference
-            PyObject *arg = reasonable_box(v);
-
-            if (!PyCheck_Type_Exact(arg, MyPyAPI.t_JV))
-            {
-                JLFreeFromMe(v);
-            }
-            PyTuple_SetItem(argtuple, i, arg);
-        }
-        return argtuple;
+        return box_tuple(jv);
     }
 
     if (JLIsInstanceWithTypeSlot(jv, MyJLAPI.t_AbstractString))
@@ -489,4 +782,21 @@ PyObject *reasonable_box(JV jv)
     return box_julia(jv);
 }
 
+// > 0 inside `with no_convert():` on this thread
+static thread_local int64_t no_convert_depth = 0;
+
+// box a result of call, getattr or getitem: with `raw` or inside `no_convert`
+// anything but `nothing` stays a JV, the caller frees `jv` if the result is not a JV
+static PyObject *box_result(JV jv, bool raw)
+{
+    if (!raw && no_convert_depth == 0)
+        return reasonable_box(jv);
+    if (JLIsInstanceWithTypeSlot(jv, MyJLAPI.t_Nothing))
+    {
+        Py_IncRef(Py_None);
+        return Py_None;
+    }
+    return box_julia(jv);
+}
+
 #endif
@@ -3,58 +3,180 @@
 
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
 #include <tyjuliacapi.hpp>
 
 static PyObject *JuliaCallError;
 static PyObject *name_jlslot;
+static PyObject *name_jlalloc;
 static JSym errorSym;
 
-PyObject *HandleJLErrorAndReturnNULL()
+// Julia exceptions raised as subclasses of both `JuliaCallError` and a Python
+// exception, so that `except IndexError` etc. work on Julia errors
+struct t_JLErrorType
 {
-    int64_t msgSize;
-    ErrorCode ret = JLError_FetchMsgSize(&msgSize);
-    if (ret != ErrorCode::ok)
+    const char *julia;
+    PyObject *const *base;
+};
+
+static const t_JLErrorType JLERROR_TYPES[] = {
+    {"BoundsError", &PyExc_IndexError},
+    {"StringIndexError", &PyExc_IndexError},
+    {"KeyError", &PyExc_KeyError},
+    {"ArgumentError", &PyExc_ValueError},
+    {"DomainError", &PyExc_ValueError},
+    {"InexactError", &PyExc_ValueError},
+    {"DimensionMismatch", &PyExc_ValueError},
+    {"MethodError", &PyExc_TypeError},
+    {"TypeError", &PyExc_TypeError},
+    {"DivideError", &PyExc_ZeroDivisionError},
+    {"OverflowError", &PyExc_OverflowError},
+    {"UndefVarError", &PyExc_NameError},
+    {"OutOfMemoryError", &PyExc_MemoryError},
+    {"StackOverflowError", &PyExc_RecursionError},
+    {"EOFError", &PyExc_EOFError},
+    {"SystemError", &PyExc_OSError},
+    {"AssertionError", &PyExc_AssertionError}};
+
+#define JLERROR_N_TYPES (sizeof(JLERROR_TYPES) / sizeof(JLERROR_TYPES[0]))
+
+static PyObject *jlerror_classes[JLERROR_N_TYPES];
+// `errorSym` of a Julia exception => Python class, filled by `init_JLErrorSymbols`
+static std::unordered_map<JSym, PyObject *> jlerror_class_of;
+// reused by every error instead of allocating one buffer per message
+static char *jlerror_buffer = NULL;
+static int64_t jlerror_buffer_size = 0;
+
+// the classes are named `_tyjuliacall_jnumpy.Julia<name>`, e.g. `JuliaBoundsError`
+static int init_JLErrorClasses(PyObject *m)
+{
+    PyObject *str = PyObject_GetAttrString(PyExc_BaseException, "__str__");
+    if (str == NULL)
+        return -1;
+    for (size_t i = 0; i < JLERROR_N_TYPES; i++)
     {
-        PyErr_SetString(JuliaCallError, "juliacall: unknown error");
-        return NULL;
+        char name[64];
+        snprintf(name, sizeof(name), "_tyjuliacall_jnumpy.Julia%s", JLERROR_TYPES[i].julia);
+        PyObject *bases = PyTuple_Pack(2, JuliaCallError, *JLERROR_TYPES[i].base);
+        // KeyError quotes its message
+        PyObject *dict = Py_BuildValue("{sO}", "__str__", str);
+        PyObject *cls = bases == NULL || dict == NULL ? NULL : PyErr_NewException(name, bases, dict);
+        Py_XDECREF(bases);
+        Py_XDECREF(dict);
+        if (cls == NULL)
+        {
+            Py_DecRef(str);
+            return -1;
+        }
+        jlerror_classes[i] = cls;
+        Py_IncRef(cls);
+        PyModule_AddObject(m, strrchr(name, '.') + 1, cls);
+    }
+    Py_DecRef(str);
+    return 0;
+}
+
+static void init_JLErrorSymbols()
+{
+    for (size_t i = 0; i < JLERROR_N_TYPES; i++)
+    {
+        JSym sym;
+        if (JSymFromString(&sym, JLERROR_TYPES[i].julia) == ErrorCode::ok)
+            jlerror_class_of[sym] = jlerror_classes[i];
     }
+}
 
-    char *errorBytes = new char[msgSize + 1]; // 动态分配足够大小的内存
-    errorBytes[msgSize] = '\0';
+static PyObject *JLErrorClass(JSym sym)
+{
+    auto it = jlerror_class_of.find(sym);
+    return it == jlerror_class_of.end() ? JuliaCallError : it->second;
+}
 
-    if (ErrorCode::ok == JLError_FetchMsgStr(&errorSym, SList_adapt(reinterpret_cast<uint8_t *>(errorBytes), msgSize + 1)))
+// fetch the pending Julia error into `jlerror_buffer`, sets `errorSym`
+static bool FetchJLErrorMsg(int64_t *msgSize)
+{
+    if (JLError_FetchMsgSize(msgSize) != ErrorCode::ok)
+        return false;
+    if (*msgSize + 1 > jlerror_buffer_size)
     {
-        PyErr_SetString(JuliaCallError, errorBytes);
+        char *buffer = (char *)realloc(jlerror_buffer, *msgSize + 1);
+        if (buffer == NULL)
+            return false;
+        jlerror_buffer = buffer;
+        jlerror_buffer_size = *msgSize + 1;
     }
-    else
+    jlerror_buffer[*msgSize] = '\0';
+    return ErrorCode::ok == JLError_FetchMsgStr(&errorSym, SList_adapt(reinterpret_cast<uint8_t *>(jlerror_buffer), *msgSize + 1));
+}
+
+PyObject *HandleJLErrorAndReturnNULL()
+{
+    int64_t msgSize;
+    if (!FetchJLErrorMsg(&msgSize))
     {
         PyErr_SetString(JuliaCallError, "juliacall: unknown error");
+        return NULL;
+    }
+    PyObject *msg = PyUnicode_DecodeUTF8(jlerror_buffer, msgSize, "replace");
+    if (msg != NULL)
+    {
+        PyErr_SetObject(JLErrorClass(errorSym), msg);
+        Py_DecRef(msg);
     }
-
-    delete[] errorBytes; // 释放动态分配的内存
     return NULL;
 }
 
 void ClearJLError()
 {
     int64_t msgSize;
-    while (ErrorCode::ok == JLError_FetchMsgSize(&msgSize))
+    while (FetchJLErrorMsg(&msgSize))
     {
-        char *errorBytes = new char[msgSize + 1]; // 动态分配足够大小的内存
-        errorBytes[msgSize] = '\0';
-
-        JLError_FetchMsgStr(&errorSym, SList_adapt(reinterpret_cast<uint8_t *>(errorBytes), msgSize + 1));
-
-        delete[] errorBytes; // 释放动态分配的内存
     }
     return;
 }
 
+// keep in sync with `NumPyScalarTypes` in tyjuliasetup/src/boot.jl
+enum struct NumPyScalarCode : int64_t
+{
+    unsupported = -1,
+    Bool = 0,
+    Int8 = 1,
+    Int16 = 2,
+    Int32 = 3,
+    Int64 = 4,
+    UInt8 = 5,
+    UInt16 = 6,
+    UInt32 = 7,
+    UInt64 = 8,
+    Float16 = 9,
+    Float32 = 10,
+    Float64 = 11,
+    ComplexF32 = 12,
+    ComplexF64 = 13,
+    datetime64 = 14,
+    timedelta64 = 15
+};
+
+// numpy scalar type object and the Julia type it converts to
+struct t_NumPyScalarType
+{
+    PyObject *type;
+    NumPyScalarCode code;
+};
+
+#define NUMPY_SCALAR_TYPE_CHARS "?bhilqBHILQefdFDMm"
+
 struct t_PyAPI
 {
     PyObject *m_builtin;
     PyObject *m_NumPy;
     PyObject *t_JV;
+    PyObject *t_JVMapping;
+    PyObject *t_JVSequence;
+    PyObject *t_JVIterator;
     PyObject *t_dict;
     PyObject *t_tuple;
     PyObject *t_int;
@@ -63,6 +185,14 @@ struct t_PyAPI
     PyObject *t_bool;
     PyObject *t_ndarray;
     PyObject *t_complex;
+    PyObject *t_bytes;
+    PyObject *t_bytearray;
+    PyObject *t_memoryview;
+    PyObject *t_npgeneric;
+    PyObject *t_npstr;
+    PyObject *t_npbytes;
+    t_NumPyScalarType numpy_scalar_types[sizeof(NUMPY_SCALAR_TYPE_CHARS) - 1];
+    int n_numpy_scalar_types;
     PyObject *f_next;
     PyObject *f_iter;
 };
@@ -82,6 +212,11 @@ struct t_JLAPI
     int64_t t_String;
     int64_t t_Number;
     int64_t t_Tuple;
+    int64_t t_NamedTuple;
+    int64_t t_VectorAny;
+    int64_t t_KeyNotFound;
+    int64_t t_IsbitsChunks;
+    int64_t t_Stepwise;
 
     JV f_eltype;
     JV f_length;
@@ -120,6 +255,16 @@ struct t_JLAPI
     JV f_tuple;
     JV f_convert;
     JV f_reshape;
+    JV f_chunked_iterator;
+    JV f_next_isbits_chunk;
+    JV f_wrap_pybuffer;
+    JV f_mapping_getitem;
+    JV f_mapping_haskey;
+    JV f_record_call;
+    JV f_record_getattr;
+    JV f_identity;
+    JV f_evaluate;
+    JV f_throw;
 
     JV obj_true;
     JV obj_false;
@@ -136,96 +281,244 @@ typedef ErrorCode (*t_pycast2jl)(/* out */ JV *out, JV T, PyObject *py);
 // return New Reference if succ, NULL on fail
 typedef PyObject *(*t_pycast2py)(JV jv);
 typedef PyObject *(*t_jlreprpretty)(JV jv);
+// fetch at most `n` elements from an `Iterators.Stateful` into `out`,
+// `*count` is the number of handles written (also on failure), and on
+// failure `*err` is the Julia exception, see RaiseJLExceptionAndReturnNULL
+typedef ErrorCode (*t_jliteratechunk)(/* out */ JV *out, int64_t n, JV stateful, /* out */ int64_t *count, /* out */ JV *err);
+// unpack a tuple in one crossing: `*n` is the arity, and if it fits in `cap`
+// element i is written either to `pys[i]` (new reference) or to `jvs[i]`
+typedef ErrorCode (*t_jlunpacktuple)(/* out */ PyObject **pys, /* out */ JV *jvs, int64_t cap, JV tuple, /* out */ int64_t *n);
+// box the value of a numpy scalar, `data` points to its C struct field `obval`
+typedef ErrorCode (*t_jlboxnumpyscalar)(/* out */ JV *out, NumPyScalarCode code, void *data);
+// write the handles of `JLAPI_TYPE_SLOTS` and `JLAPI_HANDLES` in one crossing
+typedef ErrorCode (*t_jlapibootstrap)(/* out */ JV *types, int64_t ntypes, /* out */ JV *handles, int64_t nhandles);
+// `jl_gc_total_bytes` of libjulia: bytes allocated by Julia since startup
+typedef int64_t (*t_jlgctotalbytes)(void);
+// free `n` handles in one crossing, `free` is `JLFreeFromMe` of TyJuliaCAPI
+typedef void (*t_jlfreehandles)(void *free, JV *handles, int64_t n);
+// `hash(x) % Int64` in one crossing, `*cacheable` tells if it cannot change
+// (the type of x is immutable); on failure `*err` is the Julia exception
+typedef ErrorCode (*t_jlhash)(/* out */ int64_t *out, /* out */ bool8_t *cacheable, JV x, /* out */ JV *err);
 static t_pycast2jl pycast2jl = NULL;
 static t_pycast2py pycast2py = NULL;
 static t_jlreprpretty jlreprpretty = NULL;
+static t_jliteratechunk jliteratechunk = NULL;
+static t_jlunpacktuple jlunpacktuple = NULL;
+static t_jlboxnumpyscalar jlboxnumpyscalar = NULL;
+static t_jlapibootstrap jlapibootstrap = NULL;
+static t_jlgctotalbytes jlgctotalbytes = NULL;
+static t_jlfreehandles jlfreehandles = NULL;
+static t_jlhash jlhash = NULL;
 static const JV JV_NULL = 0;
 
 static t_PyAPI MyPyAPI;
 static t_JLAPI MyJLAPI;
 
-static void init_JLAPI()
-{
-    JV t;
-    JLEval(&t, NULL, "Nothing");
-    JLTypeToIdent(&MyJLAPI.t_Nothing, t);
-    JLEval(&t, NULL, "Integer");
-    JLTypeToIdent(&MyJLAPI.t_Integer, t);
-    JLEval(&t, NULL, "AbstractFloat");
-    JLTypeToIdent(&MyJLAPI.t_AbstractFloat, t);
-    JLEval(&t, NULL, "AbstractString");
-    JLTypeToIdent(&MyJLAPI.t_AbstractString, t);
-    JLEval(&t, NULL, "Bool");
-    JLTypeToIdent(&MyJLAPI.t_Bool, t);
-    JLEval(&t, NULL, "Complex");
-    JLTypeToIdent(&MyJLAPI.t_Complex, t);
-    JLEval(&t, NULL, "AbstractSet");
-    JLTypeToIdent(&MyJLAPI.t_AbstractSet, t);
-    JLEval(&t, NULL, "AbstractDict");
-    JLTypeToIdent(&MyJLAPI.t_AbstractDict, t);
-    JLEval(&t, NULL, "AbstractArray");
-    JLTypeToIdent(&MyJLAPI.t_AbstractArray, t);
-    JLEval(&t, NULL, "BitArray");
-    JLTypeToIdent(&MyJLAPI.t_BitArray, t);
-    JLEval(&t, NULL, "String");
-    JLTypeToIdent(&MyJLAPI.t_String, t);
-    JLEval(&t, NULL, "Number");
-    JLTypeToIdent(&MyJLAPI.t_Number, t);
-    JLEval(&t, NULL, "Tuple");
-    JLTypeToIdent(&MyJLAPI.t_Tuple, t);
-
-    JLEval(&MyJLAPI.f_eltype, NULL, "Base.eltype");
-    JLEval(&MyJLAPI.f_repr, NULL, "Base.repr");
-    JLEval(&MyJLAPI.f_display, NULL, "Base.display");
-    JLEval(&MyJLAPI.f_isa, NULL, "Base.isa");
-    JLEval(&MyJLAPI.f_ncodeunits, NULL, "Base.ncodeunits");
-    JLEval(&MyJLAPI.f_square, NULL, "square(x) = x .^ 2");
-    JLEval(&MyJLAPI.f_subtype, NULL, "<:");
-    JLEval(&MyJLAPI.f_add, NULL, "Base.:+");
-    JLEval(&MyJLAPI.f_sub, NULL, "Base.:-");
-    JLEval(&MyJLAPI.f_mul, NULL, ".*");
-    JLEval(&MyJLAPI.f_matmul, NULL, "Base.:*");
-    JLEval(&MyJLAPI.f_truediv, NULL, "Base.:/");
-    JLEval(&MyJLAPI.f_floordiv, NULL, "Base.div");
-    JLEval(&MyJLAPI.f_mod, NULL, "Base.mod");
-    JLEval(&MyJLAPI.f_pow, NULL, "Base.:^");
-    JLEval(&MyJLAPI.f_lshift, NULL, "Base.:<<");
-    JLEval(&MyJLAPI.f_rshift, NULL, "Base.:>>");
-    JLEval(&MyJLAPI.f_bitor, NULL, "Base.:|");
-    JLEval(&MyJLAPI.f_bitxor, NULL, "Base.:⊻");
-    JLEval(&MyJLAPI.f_bitand, NULL, "Base.:&");
-    JLEval(&MyJLAPI.f_eq, NULL, "Base.:(==)");
-    JLEval(&MyJLAPI.f_ne, NULL, "Base.:(!=)");
-    JLEval(&MyJLAPI.f_le, NULL, "Base.:(<=)");
-    JLEval(&MyJLAPI.f_ge, NULL, "Base.:(>=)");
-    JLEval(&MyJLAPI.f_lt, NULL, "Base.:<");
-    JLEval(&MyJLAPI.f_gt, NULL, "Base.:>");
-    JLEval(&MyJLAPI.f_abs, NULL, "Base.abs");
-    JLEval(&MyJLAPI.f_abs, NULL, "Base.abs");
-    JLEval(&MyJLAPI.f_invert, NULL, "Base.:~");
-    JLEval(&MyJLAPI.f_in, NULL, "Base.in");
-    JLEval(&MyJLAPI.f_hash, NULL, "Base.hash");
-    JLEval(&MyJLAPI.f_isempty, NULL, "Base.isempty");
-    JLEval(&MyJLAPI.f_getindex, NULL, "Base.getindex");
-    JLEval(&MyJLAPI.f_setindex, NULL, "Base.setindex!");
-    JLEval(&MyJLAPI.f_tuple, NULL, "Base.tuple");
-    JLEval(&MyJLAPI.f_length, NULL, "Base.length");
-    JLEval(&MyJLAPI.f_convert, NULL, "Base.convert");
-    JLEval(&MyJLAPI.f_reshape, NULL, "Base.reshape");
-
-    JLEval(&MyJLAPI.obj_true, NULL, "true");
-    JLEval(&MyJLAPI.obj_false, NULL, "false");
-    JLEval(&MyJLAPI.obj_nothing, NULL, "nothing");
-    JLEval(&MyJLAPI.obj_zero, NULL, "0");
-    JLEval(&MyJLAPI.obj_Base, NULL, "Base");
-    JLEval(&MyJLAPI.obj_Main, NULL, "Main");
-    JLEval(&MyJLAPI.obj_Int64, NULL, "Int64");
-    // JLEval(&MyJLAPI.obj_JNumPySupportedNumPyArrayBoxingElementTypes, NULL, "Union{Int8, Int16, Int32, Int64, UInt8, UInt16, UInt32, UInt64, Float16, Float32, Float64, ComplexF16, ComplexF32, ComplexF64, Bool}");
+// keep the order in sync with `JLAPI_TYPES` in tyjuliasetup/src/boot.jl
+static int64_t t_JLAPI::*const JLAPI_TYPE_SLOTS[] = {
+    &t_JLAPI::t_Nothing,
+    &t_JLAPI::t_Integer,
+    &t_JLAPI::t_AbstractFloat,
+    &t_JLAPI::t_AbstractString,
+    &t_JLAPI::t_Bool,
+    &t_JLAPI::t_Complex,
+    &t_JLAPI::t_AbstractSet,
+    &t_JLAPI::t_AbstractDict,
+    &t_JLAPI::t_AbstractArray,
+    &t_JLAPI::t_BitArray,
+    &t_JLAPI::t_String,
+    &t_JLAPI::t_Number,
+    &t_JLAPI::t_Tuple,
+    &t_JLAPI::t_NamedTuple,
+    &t_JLAPI::t_VectorAny,
+    &t_JLAPI::t_KeyNotFound,
+    &t_JLAPI::t_IsbitsChunks,
+    &t_JLAPI::t_Stepwise};
+
+// keep the order in sync with `JLAPI_HANDLES` in tyjuliasetup/src/boot.jl
+static JV t_JLAPI::*const JLAPI_HANDLES[] = {
+    &t_JLAPI::f_eltype,
+    &t_JLAPI::f_repr,
+    &t_JLAPI::f_display,
+    &t_JLAPI::f_isa,
+    &t_JLAPI::f_ncodeunits,
+    &t_JLAPI::f_square,
+    &t_JLAPI::f_subtype,
+    &t_JLAPI::f_add,
+    &t_JLAPI::f_sub,
+    &t_JLAPI::f_mul,
+    &t_JLAPI::f_matmul,
+    &t_JLAPI::f_truediv,
+    &t_JLAPI::f_floordiv,
+    &t_JLAPI::f_mod,
+    &t_JLAPI::f_pow,
+    &t_JLAPI::f_lshift,
+    &t_JLAPI::f_rshift,
+    &t_JLAPI::f_bitor,
+    &t_JLAPI::f_bitxor,
+    &t_JLAPI::f_bitand,
+    &t_JLAPI::f_eq,
+    &t_JLAPI::f_ne,
+    &t_JLAPI::f_le,
+    &t_JLAPI::f_ge,
+    &t_JLAPI::f_lt,
+    &t_JLAPI::f_gt,
+    &t_JLAPI::f_abs,
+    &t_JLAPI::f_invert,
+    &t_JLAPI::f_in,
+    &t_JLAPI::f_hash,
+    &t_JLAPI::f_isempty,
+    &t_JLAPI::f_getindex,
+    &t_JLAPI::f_setindex,
+    &t_JLAPI::f_tuple,
+    &t_JLAPI::f_length,
+    &t_JLAPI::f_convert,
+    &t_JLAPI::f_reshape,
+    &t_JLAPI::f_chunked_iterator,
+    &t_JLAPI::f_next_isbits_chunk,
+    &t_JLAPI::f_wrap_pybuffer,
+    &t_JLAPI::f_mapping_getitem,
+    &t_JLAPI::f_mapping_haskey,
+    &t_JLAPI::f_record_call,
+    &t_JLAPI::f_record_getattr,
+    &t_JLAPI::f_identity,
+    &t_JLAPI::f_evaluate,
+    &t_JLAPI::f_throw,
+    &t_JLAPI::obj_true,
+    &t_JLAPI::obj_false,
+    &t_JLAPI::obj_nothing,
+    &t_JLAPI::obj_zero,
+    &t_JLAPI::obj_Base,
+    &t_JLAPI::obj_Main,
+    &t_JLAPI::obj_Int64,
+    &t_JLAPI::obj_String};
+
+#define JLAPI_N_TYPE_SLOTS (sizeof(JLAPI_TYPE_SLOTS) / sizeof(JLAPI_TYPE_SLOTS[0]))
+#define JLAPI_N_HANDLES (sizeof(JLAPI_HANDLES) / sizeof(JLAPI_HANDLES[0]))
+
+// fetch all types and handles with a single call into the precompiled
+// `jlapi_bootstrap`, instead of parsing and evaluating each of them
+static int init_JLAPI()
+{
+    JV types[JLAPI_N_TYPE_SLOTS];
+    JV handles[JLAPI_N_HANDLES];
+    if (jlapibootstrap(types, JLAPI_N_TYPE_SLOTS, handles, JLAPI_N_HANDLES) != ErrorCode::ok)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "failed to initialize the Julia API: TyJuliaSetup is out of sync with libjuliacall");
+        return -1;
+    }
+    for (size_t i = 0; i < JLAPI_N_TYPE_SLOTS; i++)
+    {
+        JLTypeToIdent(&(MyJLAPI.*JLAPI_TYPE_SLOTS[i]), types[i]);
+    }
+    for (size_t i = 0; i < JLAPI_N_HANDLES; i++)
+    {
+        MyJLAPI.*JLAPI_HANDLES[i] = handles[i];
+    }
+    init_JLErrorSymbols();
+    return 0;
+}
+
+// raise the Julia exception `exc` caught by a precompiled cfunction: throw it
+// again through the C API so that it gets its message and error class like
+// any other Julia error; takes the ownership of `exc`
+static PyObject *RaiseJLExceptionAndReturnNULL(JV exc)
+{
+    JV jret;
+    ErrorCode ret = JLCall(&jret, MyJLAPI.f_throw, SList_adapt(&exc, 1), emptyKwArgs());
+    JLFreeFromMe(exc);
+    if (ret != ErrorCode::ok)
+        return HandleJLErrorAndReturnNULL();
+    JLFreeFromMe(jret);
+    PyErr_SetString(JuliaCallError, "juliacall: unknown error");
+    return NULL;
+}
+
+static NumPyScalarCode numpy_scalar_code_of(char kind, long itemsize)
+{
+    int log2size = itemsize == 1 ? 0 : itemsize == 2 ? 1 : itemsize == 4 ? 2 : itemsize == 8 ? 3 : -1;
+    switch (kind)
+    {
+    case 'b':
+        return NumPyScalarCode::Bool;
+    case 'i':
+        if (log2size >= 0)
+            return (NumPyScalarCode)((int64_t)NumPyScalarCode::Int8 + log2size);
+        break;
+    case 'u':
+        if (log2size >= 0)
+            return (NumPyScalarCode)((int64_t)NumPyScalarCode::UInt8 + log2size);
+        break;
+    case 'f':
+        if (itemsize == 2)
+            return NumPyScalarCode::Float16;
+        if (itemsize == 4)
+            return NumPyScalarCode::Float32;
+        if (itemsize == 8)
+            return NumPyScalarCode::Float64;
+        break;
+    case 'c':
+        if (itemsize == 8)
+            return NumPyScalarCode::ComplexF32;
+        if (itemsize == 16)
+            return NumPyScalarCode::ComplexF64;
+        break;
+    case 'M':
+        return NumPyScalarCode::datetime64;
+    case 'm':
+        return NumPyScalarCode::timedelta64;
+    }
+    return NumPyScalarCode::unsupported;
+}
+
+static void init_NumPyScalarTypes()
+{
+    // C type names such as 'l' map to different sizes on different platforms,
+    // so ask numpy instead of hard-coding np.int64 etc.
+    MyPyAPI.n_numpy_scalar_types = 0;
+    const char *chars = NUMPY_SCALAR_TYPE_CHARS;
+    for (size_t i = 0; chars[i] != '\0'; i++)
+    {
+        char name[2] = {chars[i], '\0'};
+        PyObject *dtype = PyObject_CallMethod(MyPyAPI.m_NumPy, "dtype", "s", name);
+        if (dtype == NULL)
+        {
+            PyErr_Clear();
+            continue;
+        }
+        PyObject *type = PyObject_GetAttrString(dtype, "type");
+        PyObject *kind = PyObject_GetAttrString(dtype, "kind");
+        PyObject *itemsize = PyObject_GetAttrString(dtype, "itemsize");
+        Py_DecRef(dtype);
+        if (type == NULL || kind == NULL || itemsize == NULL)
+        {
+            PyErr_Clear();
+            Py_XDECREF(type);
+            Py_XDECREF(kind);
+            Py_XDECREF(itemsize);
+            continue;
+        }
+        PyObject *kindbytes = PyUnicode_AsUTF8String(kind);
+        char kindchar = kindbytes == NULL ? '\0' : PyBytes_AsString(kindbytes)[0];
+        NumPyScalarCode code = numpy_scalar_code_of(kindchar, PyLong_AsLong(itemsize));
+        Py_XDECREF(kindbytes);
+        Py_DecRef(kind);
+        Py_DecRef(itemsize);
+        if (code == NumPyScalarCode::unsupported)
+        {
+            PyErr_Clear();
+            Py_DecRef(type);
+            continue;
+        }
+        MyPyAPI.numpy_scalar_types[MyPyAPI.n_numpy_scalar_types++] = t_NumPyScalarType{type, code};
+    }
 }
 
-static void init_PyAPI(PyObject *t_JV)
+static void init_PyAPI(PyObject *t_JV, PyObject *m_jv)
 {
     MyPyAPI.t_JV = t_JV;
+    MyPyAPI.t_JVMapping = PyObject_GetAttrString(m_jv, "JVMapping");
+    MyPyAPI.t_JVSequence = PyObject_GetAttrString(m_jv, "JVSequence");
     MyPyAPI.m_builtin = PyImport_ImportModule("builtins");
     MyPyAPI.m_NumPy = PyImport_ImportModule("numpy");
     MyPyAPI.t_dict = PyObject_GetAttrString(MyPyAPI.m_builtin, "dict");
@@ -236,6 +529,13 @@ static void init_PyAPI(PyObject *t_JV)
     MyPyAPI.t_bool = PyObject_GetAttrString(MyPyAPI.m_builtin, "bool");
     MyPyAPI.t_ndarray = PyObject_GetAttrString(MyPyAPI.m_NumPy, "ndarray");
     MyPyAPI.t_complex = PyObject_GetAttrString(MyPyAPI.m_builtin, "complex");
+    MyPyAPI.t_bytes = PyObject_GetAttrString(MyPyAPI.m_builtin, "bytes");
+    MyPyAPI.t_bytearray = PyObject_GetAttrString(MyPyAPI.m_builtin, "bytearray");
+    MyPyAPI.t_memoryview = PyObject_GetAttrString(MyPyAPI.m_builtin, "memoryview");
+    MyPyAPI.t_npgeneric = PyObject_GetAttrString(MyPyAPI.m_NumPy, "generic");
+    MyPyAPI.t_npstr = PyObject_GetAttrString(MyPyAPI.m_NumPy, "str_");
+    MyPyAPI.t_npbytes = PyObject_GetAttrString(MyPyAPI.m_NumPy, "bytes_");
+    init_NumPyScalarTypes();
     MyPyAPI.f_next = PyObject_GetAttrString(MyPyAPI.m_builtin, "next");
     MyPyAPI.f_iter = PyObject_GetAttrString(MyPyAPI.m_builtin, "iter");
 }
@@ -2,17 +2,29 @@
 #include <Python.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <unordered_map>
 
 #include <TyPython.hpp>
 #include <common.hpp>
 #include <tyjuliacapi.hpp>
+#include <JVIterator.hpp>
+#include <Stats.hpp>
 
 DLLEXPORT int init_libjuliacall(void *lpfnJLCApiGetter,
                                 void *lpfnPyCast2JL,
                                 void *lpfnPyCast2Py,
-                                void *lpfnJLReprPretty)
+                                void *lpfnJLReprPretty,
+                                void *lpfnJLIterateChunk,
+                                void *lpfnJLUnpackTuple,
+                                void *lpfnJLBoxNumPyScalar,
+                                void *lpfnJLAPIBootstrap,
+                                void *lpfnJLGCTotalBytes,
+                                void *lpfnJLFreeHandles,
+                                void *lpfnJLHash)
 {
-  if (pycast2jl != NULL && pycast2py != NULL && jlreprpretty != NULL)
+  if (pycast2jl != NULL && pycast2py != NULL && jlreprpretty != NULL && jliteratechunk != NULL &&
+      jlunpacktuple != NULL && jlboxnumpyscalar != NULL && jlapibootstrap != NULL && jlgctotalbytes != NULL &&
+      jlfreehandles != NULL && jlhash != NULL)
   {
     return 0;
   }
@@ -26,28 +38,121 @@ DLLEXPORT int init_libjuliacall(void *lpfnJLCApiGetter,
   pycast2jl = (t_pycast2jl)lpfnPyCast2JL;
   pycast2py = (t_pycast2py)lpfnPyCast2Py;
   jlreprpretty = (t_jlreprpretty)lpfnJLReprPretty;
+  jliteratechunk = (t_jliteratechunk)lpfnJLIterateChunk;
+  jlunpacktuple = (t_jlunpacktuple)lpfnJLUnpackTuple;
+  jlboxnumpyscalar = (t_jlboxnumpyscalar)lpfnJLBoxNumPyScalar;
+  jlapibootstrap = (t_jlapibootstrap)lpfnJLAPIBootstrap;
+  jlgctotalbytes = (t_jlgctotalbytes)lpfnJLGCTotalBytes;
+  jlfreehandles = (t_jlfreehandles)lpfnJLFreeHandles;
+  jlhash = (t_jlhash)lpfnJLHash;
 
   return 0;
 }
 
+// when on, the calls made by the entry points below are also passed to
+// `TyJuliaSetup.record_call`, which logs their concrete signatures
+static bool8_t jl_recording = false;
+
+static void record_call(JV f, JV *args, int64_t nargs, SList<STuple<JSym, JV>> kwargs)
+{
+  JV *jargs = (JV *)malloc((nargs + 1) * sizeof(JV));
+  jargs[0] = f;
+  for (int64_t i = 0; i < nargs; i++)
+  {
+    jargs[i + 1] = args[i];
+  }
+  // recording is best effort and never fails the recorded call
+  JV jret;
+  if (JLCall(&jret, MyJLAPI.f_record_call, SList_adapt(jargs, nargs + 1), kwargs) == ErrorCode::ok)
+  {
+    JLFreeFromMe(jret);
+  }
+  free(jargs);
+}
+
+static void record_getattr(JV slf, const char *attr)
+{
+  JV jattr;
+  ToJLString(&jattr, SList_adapt(reinterpret_cast<uint8_t *>(const_cast<char *>(attr)), strlen(attr)));
+  JV jargs[2] = {slf, jattr};
+  JV jret;
+  if (JLCall(&jret, MyJLAPI.f_record_getattr, SList_adapt(jargs, 2), emptyKwArgs()) == ErrorCode::ok)
+  {
+    JLFreeFromMe(jret);
+  }
+  JLFreeFromMe(jattr);
+}
+
+static PyObject *jl_set_recording(PyObject *self, PyObject *arg)
+{
+  int on = PyObject_IsTrue(arg);
+  if (on < 0)
+  {
+    return NULL;
+  }
+  PyObject *was = jl_recording ? Py_True : Py_False;
+  jl_recording = on;
+  Py_INCREF(was);
+  return was;
+}
+
 static PyObject *jl_eval(PyObject *self, PyObject *args)
 {
-  const char *_command;
-  JV result;
-  if (!PyArg_ParseTuple(args, "s", &_command))
+  EntryStatsScope stats(EntryPoint::eval);
+  // jl_eval(command: str, module: JV = None, filename: str = None, line: int = 1)
+  // `TyJuliaSetup.evaluate_cached` parses `command` as a whole file
+  // (`Meta.parseall`) once and evaluates it in `module`, Main by default
+  PyObject *command;
+  PyObject *module = Py_None;
+  PyObject *filename = Py_None;
+  Py_ssize_t line = 1;
+  if (!PyArg_ParseTuple(args, "U|OOn", &command, &module, &filename, &line))
+  {
+    return NULL;
+  }
+  if (module != Py_None && !PyCheck_JV(module))
   {
+    PyErr_SetString(JuliaCallError, "jl_eval: module must be a JV of a Julia module.");
     return NULL;
   }
-  char *command = const_cast<char *>(_command);
-  ErrorCode ret = JLEval(
-      &result, NULL,
-      SList_adapt(reinterpret_cast<uint8_t *>(command), strlen(command)));
+  if (filename != Py_None && !PyUnicode_Check(filename))
+  {
+    PyErr_SetString(JuliaCallError, "jl_eval: filename must be a str.");
+    return NULL;
+  }
+  PyObject *evalargs = Py_BuildValue("(OOOn)", command, module, filename, line);
+  if (evalargs == NULL)
+  {
+    return NULL;
+  }
+  JV jargs[4] = {JV_NULL, JV_NULL, JV_NULL, JV_NULL};
+  bool8_t jargs_tobefree[4] = {false, false, false, false};
+  ErrorCode ret = ToJListFromPyTuple(jargs, jargs_tobefree, evalargs, 4);
+  Py_DecRef(evalargs);
+  if (ret != ErrorCode::ok)
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      if (jargs_tobefree[i])
+        JLFreeFromMe(jargs[i]);
+    }
+    return HandleJLErrorAndReturnNULL();
+  }
+  stats.enter(StatsPhase::call);
+  JV result;
+  ret = JLCall(&result, MyJLAPI.f_evaluate, SList_adapt(jargs, 4), emptyKwArgs());
+  for (int i = 0; i < 4; i++)
+  {
+    if (jargs_tobefree[i])
+      JLFreeFromMe(jargs[i]);
+  }
   if (ret != ErrorCode::ok)
   {
     return HandleJLErrorAndReturnNULL(); // 如果是错误的话，则处理
   }
-  PyObject *pyout = reasonable_box(result);
-  if (!PyCheck_Type_Exact(pyout, MyPyAPI.t_JV))
+  stats.enter(StatsPhase::box);
+  PyObject *pyout = box_result(result, false);
+  if (!PyCheck_JV(pyout))
   {
     // if pyout is a JV object, we should not free it from Julia.
     JLFreeFromMe(result);
@@ -57,8 +162,9 @@ static PyObject *jl_eval(PyObject *self, PyObject *args)
 
 static PyObject *jl_display(PyObject *self, PyObject *arg)
 {
+  EntryStatsScope stats(EntryPoint::display);
   // check arg type
-  if (!PyCheck_Type_Exact(arg, MyPyAPI.t_JV))
+  if (!PyCheck_JV(arg))
   {
     PyErr_SetString(JuliaCallError, "jl_display: expect object of JV class.");
     return NULL;
@@ -69,12 +175,14 @@ static PyObject *jl_display(PyObject *self, PyObject *arg)
   JV jret;
 
   // call julia function repr
+  stats.enter(StatsPhase::call);
   ErrorCode ret = JLCall(&jret, MyJLAPI.f_repr, SList_adapt(&jv, 1), emptyKwArgs());
   if (ret != ErrorCode::ok)
   {
     return HandleJLErrorAndReturnNULL();
   }
 
+  stats.enter(StatsPhase::box);
   PyObject *pyjv = pycast2py(jret);
   if (pyjv == NULL)
   {
@@ -88,7 +196,8 @@ static PyObject *jl_display(PyObject *self, PyObject *arg)
 
 static PyObject *jl_repr_pretty(PyObject *self, PyObject *arg)
 {
-  if (!PyCheck_Type_Exact(arg, MyPyAPI.t_JV))
+  EntryStatsScope stats(EntryPoint::repr_pretty);
+  if (!PyCheck_JV(arg))
   {
     PyErr_SetString(JuliaCallError, "jl_display: expect object of JV class.");
     return NULL;
@@ -96,6 +205,7 @@ static PyObject *jl_repr_pretty(PyObject *self, PyObject *arg)
 
   // unbox jv from arg (use unbox_julia)
   JV jv = unbox_julia(arg);
+  stats.enter(StatsPhase::call);
   PyObject *res = jlreprpretty(jv);
   if (res == NULL)
   {
@@ -104,8 +214,10 @@ static PyObject *jl_repr_pretty(PyObject *self, PyObject *arg)
   return res;
 }
 
-static PyObject *jl_call(PyObject *self, PyObject *args)
+// `raw`: return the result as a JV, see `no_convert` in tyjuliasetup/__init__.py
+static PyObject *jl_call_impl(PyObject *args, bool raw)
 {
+  EntryStatsScope stats(EntryPoint::call);
   PyObject *pyjv, *posargs, *kwargs;
   JV slf;
   if (!PyArg_ParseTuple(args, "OOO", &pyjv, &posargs, &kwargs))
@@ -113,14 +225,16 @@ static PyObject *jl_call(PyObject *self, PyObject *args)
     return NULL;
   }
 
-  if (!PyCheck_Type_Exact(pyjv, MyPyAPI.t_JV))
+  if (!PyCheck_JV(pyjv))
   {
     PyErr_SetString(JuliaCallError, "jl_call: expect object of JV class.");
     return NULL;
   }
   else
   {
-    slf = unbox_julia(pyjv);
+    t_JVSlot *slot = jv_slot_of(pyjv);
+    slf = slot->jv;
+    raw = raw || slot->raw;
   }
 
   if (!PyCheck_Type_Exact(posargs, MyPyAPI.t_tuple))
@@ -181,6 +295,13 @@ static PyObject *jl_call(PyObject *self, PyObject *args)
     jlkwargs[i] = STuple<JSym, JV>{jv_key_list[i], jv_value_list[i]};
   }
 
+  stats.enter(StatsPhase::call);
+  stats.callee = slf;
+  if (jl_recording)
+  {
+    record_call(slf, jlargs, nargs, SList_adapt(jlkwargs, nkargs));
+  }
+
   JV out;
   ret = JLCall(&out, slf, SList_adapt(jlargs, nargs),
                SList_adapt(jlkwargs, nkargs));
@@ -194,12 +315,14 @@ static PyObject *jl_call(PyObject *self, PyObject *args)
     return HandleJLErrorAndReturnNULL();
   }
 
-  PyObject *pyout = reasonable_box(out);
-  if (!PyCheck_Type_Exact(pyout, MyPyAPI.t_JV))
+  stats.enter(StatsPhase::box);
+  PyObject *pyout = box_result(out, raw);
+  if (!PyCheck_JV(pyout))
   {
     // if pyout is a JV object, we should not free it from Julia.
     JLFreeFromMe(out);
   }
+  stats.annotate(pyout);
 
   free(jv_key_list);
   free_jv_list(jlargs, jv_tobefree, nargs);
@@ -208,8 +331,19 @@ static PyObject *jl_call(PyObject *self, PyObject *args)
   return pyout;
 }
 
+static PyObject *jl_call(PyObject *self, PyObject *args)
+{
+  return jl_call_impl(args, false);
+}
+
+static PyObject *jl_call_raw(PyObject *self, PyObject *args)
+{
+  return jl_call_impl(args, true);
+}
+
 static PyObject *jl_getattr(PyObject *self, PyObject *args)
 {
+  EntryStatsScope stats(EntryPoint::getattr);
   PyObject *pyjv;
   const char *attr;
   if (!PyArg_ParseTuple(args, "Os", &pyjv, &attr))
@@ -217,7 +351,7 @@ static PyObject *jl_getattr(PyObject *self, PyObject *args)
     return NULL;
   }
   JV slf;
-  if (!PyCheck_Type_Exact(pyjv, MyPyAPI.t_JV))
+  if (!PyCheck_JV(pyjv))
   {
     PyErr_SetString(JuliaCallError, "jl_getattr: expect object of JV class.");
     return NULL;
@@ -227,6 +361,13 @@ static PyObject *jl_getattr(PyObject *self, PyObject *args)
     slf = unbox_julia(pyjv);
   }
 
+  stats.enter(StatsPhase::call);
+  stats.attr = attr;
+  if (jl_recording)
+  {
+    record_getattr(slf, attr);
+  }
+
   JSym sym;
   JSymFromString(&sym, attr);
 
@@ -237,8 +378,9 @@ static PyObject *jl_getattr(PyObject *self, PyObject *args)
     return HandleJLErrorAndReturnNULL();
   }
 
-  PyObject *pyout = reasonable_box(out);
-  if (!PyCheck_Type_Exact(pyout, MyPyAPI.t_JV))
+  stats.enter(StatsPhase::box);
+  PyObject *pyout = box_result(out, false);
+  if (!PyCheck_JV(pyout))
   {
     // if pyout is a JV object, we should not free it from Julia.
     JLFreeFromMe(out);
@@ -248,6 +390,7 @@ static PyObject *jl_getattr(PyObject *self, PyObject *args)
 
 static PyObject *jl_setattr(PyObject *self, PyObject *args)
 {
+  EntryStatsScope stats(EntryPoint::setattr);
   // jl_setattr(self: JV, attr: str, value)
   // 1. check args type, we should get 3 args:
   //    PyObject* pyjv, const char* attr, PyObject* value
@@ -260,7 +403,7 @@ static PyObject *jl_setattr(PyObject *self, PyObject *args)
   }
   // 2. check pyjv is a JV object, and unbox it as JV
   JV slf;
-  if (!PyCheck_Type_Exact(pyjv, MyPyAPI.t_JV))
+  if (!PyCheck_JV(pyjv))
   {
     PyErr_SetString(JuliaCallError, "jl_getattr: expect object of JV class.");
     return NULL;
@@ -277,6 +420,8 @@ static PyObject *jl_setattr(PyObject *self, PyObject *args)
     return NULL;
   }
   // 4. call JLSetProperty
+  stats.enter(StatsPhase::call);
+  stats.attr = attr;
   JSym sym;
   JSymFromString(&sym, attr);
   ErrorCode ret = JLSetProperty(slf, sym, v);
@@ -300,6 +445,7 @@ static PyObject *jl_setattr(PyObject *self, PyObject *args)
 
 static PyObject *jl_hasattr(PyObject *self, PyObject *args)
 {
+  EntryStatsScope stats(EntryPoint::hasattr);
   PyObject *pyjv;
   const char *attr;
   if (!PyArg_ParseTuple(args, "Os", &pyjv, &attr))
@@ -308,7 +454,7 @@ static PyObject *jl_hasattr(PyObject *self, PyObject *args)
   }
 
   JV slf;
-  if (!PyCheck_Type_Exact(pyjv, MyPyAPI.t_JV))
+  if (!PyCheck_JV(pyjv))
   {
     PyErr_SetString(JuliaCallError, "jl_hasattr: expect object of JV class.");
     return NULL;
@@ -318,6 +464,8 @@ static PyObject *jl_hasattr(PyObject *self, PyObject *args)
     slf = unbox_julia(pyjv);
   }
 
+  stats.enter(StatsPhase::call);
+  stats.attr = attr;
   JSym sym;
   JSymFromString(&sym, attr);
 
@@ -327,6 +475,7 @@ static PyObject *jl_hasattr(PyObject *self, PyObject *args)
   {
     return HandleJLErrorAndReturnNULL();
   }
+  stats.enter(StatsPhase::box);
 
   if (out)
   {
@@ -340,6 +489,7 @@ static PyObject *jl_hasattr(PyObject *self, PyObject *args)
 
 static PyObject *jl_getitem(PyObject *self, PyObject *args)
 {
+  EntryStatsScope stats(EntryPoint::getitem);
   PyObject *pyjv;
   PyObject *item;
   if (!PyArg_ParseTuple(args, "OO", &pyjv, &item))
@@ -348,7 +498,7 @@ static PyObject *jl_getitem(PyObject *self, PyObject *args)
   }
   // check pyjv is a JV object, and unbox it as JV
   JV slf;
-  if (!PyCheck_Type_Exact(pyjv, MyPyAPI.t_JV))
+  if (!PyCheck_JV(pyjv))
   {
     PyErr_SetString(JuliaCallError, "jl_getitem: expect object of JV class.");
     return NULL;
@@ -382,6 +532,12 @@ static PyObject *jl_getitem(PyObject *self, PyObject *args)
       return HandleJLErrorAndReturnNULL();
     }
 
+    stats.enter(StatsPhase::call);
+    if (jl_recording)
+    {
+      record_call(MyJLAPI.f_getindex, jv_list, length, emptyKwArgs());
+    }
+
     JV jret;
     ret = JLCall(&jret, MyJLAPI.f_getindex, SList_adapt(jv_list, length),
                  emptyKwArgs());
@@ -391,8 +547,9 @@ static PyObject *jl_getitem(PyObject *self, PyObject *args)
       return HandleJLErrorAndReturnNULL();
     }
 
-    PyObject *py = reasonable_box(jret);
-    if (!PyCheck_Type_Exact(py, MyPyAPI.t_JV))
+    stats.enter(StatsPhase::box);
+    PyObject *py = box_result(jret, false);
+    if (!PyCheck_JV(py))
     {
       // if pyout is a JV object, we should not free it from Julia.
       JLFreeFromMe(jret);
@@ -411,6 +568,11 @@ static PyObject *jl_getitem(PyObject *self, PyObject *args)
     JV jargs[2];
     jargs[0] = slf;
     jargs[1] = v;
+    stats.enter(StatsPhase::call);
+    if (jl_recording)
+    {
+      record_call(MyJLAPI.f_getindex, jargs, 2, emptyKwArgs());
+    }
     ErrorCode ret2 =
         JLCall(&jret, MyJLAPI.f_getindex, SList_adapt(jargs, 2), emptyKwArgs());
     if (needToBeFree)
@@ -422,8 +584,9 @@ static PyObject *jl_getitem(PyObject *self, PyObject *args)
     {
       return HandleJLErrorAndReturnNULL();
     }
-    PyObject *py = reasonable_box(jret);
-    if (!PyCheck_Type_Exact(py, MyPyAPI.t_JV))
+    stats.enter(StatsPhase::box);
+    PyObject *py = box_result(jret, false);
+    if (!PyCheck_JV(py))
     {
       // if pyout is a JV object, we should not free it from Julia.
       JLFreeFromMe(jret);
@@ -434,13 +597,14 @@ static PyObject *jl_getitem(PyObject *self, PyObject *args)
 
 static PyObject *jl_setitem(PyObject *self, PyObject *args)
 {
+  EntryStatsScope stats(EntryPoint::setitem);
   PyObject *pyjv, *item, *val;
   JV slf;
   if (!PyArg_ParseTuple(args, "OOO", &pyjv, &item, &val))
   {
     return NULL;
   }
-  if (!PyCheck_Type_Exact(pyjv, MyPyAPI.t_JV))
+  if (!PyCheck_JV(pyjv))
   {
     PyErr_SetString(JuliaCallError, "jl_setitem: expect object of JV class.");
     return NULL;
@@ -473,6 +637,12 @@ static PyObject *jl_setitem(PyObject *self, PyObject *args)
       return HandleJLErrorAndReturnNULL();
     }
 
+    stats.enter(StatsPhase::call);
+    if (jl_recording)
+    {
+      record_call(MyJLAPI.f_setindex, jv_list, length, emptyKwArgs());
+    }
+
     JV jret;
     ret = JLCall(&jret, MyJLAPI.f_setindex, SList_adapt(jv_list, length),
                  emptyKwArgs());
@@ -481,20 +651,14 @@ static PyObject *jl_setitem(PyObject *self, PyObject *args)
     {
       return HandleJLErrorAndReturnNULL();
     }
-
-    PyObject *py = reasonable_box(jret);
-    if (!PyCheck_Type_Exact(py, MyPyAPI.t_JV))
-    {
-      // if pyout is a JV object, we should not free it from Julia.
-      JLFreeFromMe(jret);
-    }
-    return py;
+    // `__setitem__` returns None, the container returned by setindex! is not boxed
+    JLFreeFromMe(jret);
   }
   else
   {
     JV jret;
-    bool8_t needToBeFree_val;
-    bool8_t needToBeFree_item;
+    bool8_t needToBeFree_val = false;
+    bool8_t needToBeFree_item = false;
     JV v = reasonable_unbox(val, &needToBeFree_val);
     if (v == JV_NULL)
     {
@@ -511,6 +675,11 @@ static PyObject *jl_setitem(PyObject *self, PyObject *args)
     jargs[0] = slf;
     jargs[1] = v;
     jargs[2] = j_itme;
+    stats.enter(StatsPhase::call);
+    if (jl_recording)
+    {
+      record_call(MyJLAPI.f_setindex, jargs, 3, emptyKwArgs());
+    }
     ErrorCode ret2 =
         JLCall(&jret, MyJLAPI.f_setindex, SList_adapt(jargs, 3), emptyKwArgs());
     if (needToBeFree_val)
@@ -522,20 +691,18 @@ static PyObject *jl_setitem(PyObject *self, PyObject *args)
     {
       return HandleJLErrorAndReturnNULL();
     }
-    PyObject *py = reasonable_box(jret);
-    if (!PyCheck_Type_Exact(py, MyPyAPI.t_JV))
-    {
-      // if pyout is a JV object, we should not free it from Julia.
-      JLFreeFromMe(jret);
-    }
-    return py;
+    JLFreeFromMe(jret);
   }
   Py_INCREF(Py_None);
   return Py_None;
 }
 
-static PyObject *jl_binary_operation(PyObject *self, PyObject *args, JV f, bool8_t reverse = false)
+// with `compare`, a Bool result is returned as a Python bool without boxing;
+// others (`missing`, custom types) are boxed as usual. `f` is called exactly
+// once either way, so its side effects and errors are never duplicated.
+static PyObject *jl_binary_operation(PyObject *self, PyObject *args, EntryPoint ep, JV f, bool8_t reverse = false, bool8_t compare = false)
 {
+  EntryStatsScope stats(ep);
   // 1. check args type
   PyObject *pyjv;
   PyObject *value;
@@ -545,7 +712,7 @@ static PyObject *jl_binary_operation(PyObject *self, PyObject *args, JV f, bool8
   }
   // 2. check pyjv is a JV object, and unbox it as JV
   JV slf;
-  if (!PyCheck_Type_Exact(pyjv, MyPyAPI.t_JV))
+  if (!PyCheck_JV(pyjv))
   {
     PyErr_SetString(JuliaCallError, "expect object of JV class.");
     return NULL;
@@ -577,8 +744,14 @@ static PyObject *jl_binary_operation(PyObject *self, PyObject *args, JV f, bool8
     jargs[1] = v;
   }
 
-  ErrorCode ret;
-  ret = JLCall(&jret, f, SList_adapt(jargs, 2), emptyKwArgs());
+  stats.enter(StatsPhase::call);
+  stats.callee = f;
+  if (jl_recording)
+  {
+    record_call(f, jargs, 2, emptyKwArgs());
+  }
+
+  ErrorCode ret = JLCall(&jret, f, SList_adapt(jargs, 2), emptyKwArgs());
   if (needToBeFree)
     JLFreeFromMe(v);
 
@@ -587,8 +760,19 @@ static PyObject *jl_binary_operation(PyObject *self, PyObject *args, JV f, bool8
   {
     return HandleJLErrorAndReturnNULL();
   }
+  stats.enter(StatsPhase::box);
+  if (compare && JLIsInstanceWithTypeSlot(jret, MyJLAPI.t_Bool))
+  {
+    bool8_t result;
+    if (JLGetBool(&result, jret, false) == ErrorCode::ok)
+    {
+      JLFreeFromMe(jret);
+      return PyBool_FromLong(result);
+    }
+    ClearJLError();
+  }
   PyObject *py = reasonable_box(jret);
-  if (!PyCheck_Type_Exact(py, MyPyAPI.t_JV))
+  if (!PyCheck_JV(py))
   {
     // if pyout is a JV object, we should not free it from Julia.
     JLFreeFromMe(jret);
@@ -598,109 +782,110 @@ static PyObject *jl_binary_operation(PyObject *self, PyObject *args, JV f, bool8
 
 static PyObject *jl_add(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_add);
+  return jl_binary_operation(self, args, EntryPoint::add, MyJLAPI.f_add);
 }
 
 static PyObject *jl_sub(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_sub);
+  return jl_binary_operation(self, args, EntryPoint::sub, MyJLAPI.f_sub);
 }
 
 static PyObject *jl_mul(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_mul);
+  return jl_binary_operation(self, args, EntryPoint::mul, MyJLAPI.f_mul);
 }
 
 static PyObject *jl_matmul(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_matmul);
+  return jl_binary_operation(self, args, EntryPoint::matmul, MyJLAPI.f_matmul);
 }
 
 static PyObject *jl_truediv(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_truediv);
+  return jl_binary_operation(self, args, EntryPoint::truediv, MyJLAPI.f_truediv);
 }
 
 static PyObject *jl_floordiv(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_floordiv);
+  return jl_binary_operation(self, args, EntryPoint::floordiv, MyJLAPI.f_floordiv);
 }
 
 static PyObject *jl_mod(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_mod);
+  return jl_binary_operation(self, args, EntryPoint::mod, MyJLAPI.f_mod);
 }
 
 static PyObject *jl_pow(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_pow);
+  return jl_binary_operation(self, args, EntryPoint::pow, MyJLAPI.f_pow);
 }
 
 static PyObject *jl_lshift(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_lshift);
+  return jl_binary_operation(self, args, EntryPoint::lshift, MyJLAPI.f_lshift);
 }
 
 static PyObject *jl_rshift(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_rshift);
+  return jl_binary_operation(self, args, EntryPoint::rshift, MyJLAPI.f_rshift);
 }
 
 static PyObject *jl_bitor(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_bitor);
+  return jl_binary_operation(self, args, EntryPoint::bitor_, MyJLAPI.f_bitor);
 }
 
 static PyObject *jl_bitxor(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_bitxor);
+  return jl_binary_operation(self, args, EntryPoint::bitxor, MyJLAPI.f_bitxor);
 }
 
 static PyObject *jl_bitand(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_bitand);
+  return jl_binary_operation(self, args, EntryPoint::bitand_, MyJLAPI.f_bitand);
 }
 
 static PyObject *jl_eq(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_eq);
+  return jl_binary_operation(self, args, EntryPoint::eq, MyJLAPI.f_eq, false, true);
 }
 
 static PyObject *jl_ne(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_ne);
+  return jl_binary_operation(self, args, EntryPoint::ne, MyJLAPI.f_ne, false, true);
 }
 
 static PyObject *jl_lt(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_lt);
+  return jl_binary_operation(self, args, EntryPoint::lt, MyJLAPI.f_lt, false, true);
 }
 
 static PyObject *jl_le(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_le);
+  return jl_binary_operation(self, args, EntryPoint::le, MyJLAPI.f_le, false, true);
 }
 
 static PyObject *jl_gt(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_gt);
+  return jl_binary_operation(self, args, EntryPoint::gt, MyJLAPI.f_gt, false, true);
 }
 
 static PyObject *jl_ge(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_ge);
+  return jl_binary_operation(self, args, EntryPoint::ge, MyJLAPI.f_ge, false, true);
 }
 
 static PyObject *jl_contains(PyObject *self, PyObject *args)
 {
-  return jl_binary_operation(self, args, MyJLAPI.f_in, true);
+  return jl_binary_operation(self, args, EntryPoint::contains, MyJLAPI.f_in, true);
 }
 
-static PyObject *jl_unary_opertation(PyObject *self, PyObject *args, JV f)
+static PyObject *jl_unary_opertation(PyObject *self, PyObject *args, EntryPoint ep, JV f)
 {
+  EntryStatsScope stats(ep);
   // 1. check pyjv is a JV object, and unbox it as JV
   JV slf;
-  if (!PyCheck_Type_Exact(args, MyPyAPI.t_JV))
+  if (!PyCheck_JV(args))
   {
     PyErr_SetString(JuliaCallError, "expect object of JV class.");
     return NULL;
@@ -709,6 +894,12 @@ static PyObject *jl_unary_opertation(PyObject *self, PyObject *args, JV f)
   {
     slf = unbox_julia(args);
   }
+  stats.enter(StatsPhase::call);
+  stats.callee = f;
+  if (jl_recording)
+  {
+    record_call(f, &slf, 1, emptyKwArgs());
+  }
   // 3. call JLCallS
   JV jret;
   ErrorCode ret;
@@ -718,8 +909,9 @@ static PyObject *jl_unary_opertation(PyObject *self, PyObject *args, JV f)
   {
     return HandleJLErrorAndReturnNULL();
   }
+  stats.enter(StatsPhase::box);
   PyObject *py = reasonable_box(jret);
-  if (!PyCheck_Type_Exact(py, MyPyAPI.t_JV))
+  if (!PyCheck_JV(py))
   {
     // if pyout is a JV object, we should not free it from Julia.
     JLFreeFromMe(jret);
@@ -729,29 +921,59 @@ static PyObject *jl_unary_opertation(PyObject *self, PyObject *args, JV f)
 
 static PyObject *jl_invert(PyObject *self, PyObject *args)
 {
-  return jl_unary_opertation(self, args, MyJLAPI.f_invert);
+  return jl_unary_opertation(self, args, EntryPoint::invert, MyJLAPI.f_invert);
 }
 
 static PyObject *jl_pos(PyObject *self, PyObject *args)
 {
-  return jl_unary_opertation(self, args, MyJLAPI.f_add);
+  return jl_unary_opertation(self, args, EntryPoint::pos, MyJLAPI.f_add);
 }
 
 static PyObject *jl_neg(PyObject *self, PyObject *args)
 {
-  return jl_unary_opertation(self, args, MyJLAPI.f_sub);
+  return jl_unary_opertation(self, args, EntryPoint::neg, MyJLAPI.f_sub);
 }
 
 static PyObject *jl_abs(PyObject *self, PyObject *args)
 {
-  return jl_unary_opertation(self, args, MyJLAPI.f_abs);
+  return jl_unary_opertation(self, args, EntryPoint::abs, MyJLAPI.f_abs);
+}
+
+// how `JV.__bool__` decides for the values of a concrete type
+enum struct Truthiness : uint8_t
+{
+    nonzero, // Number: x != 0
+    nonempty, // AbstractArray, AbstractDict, AbstractSet, AbstractString: !isempty(x)
+    always // any other object is true, like a Python object without __bool__/__len__
+};
+
+// by type slot, filled by the first value of each type
+static std::unordered_map<int64_t, Truthiness> truthiness_of_type;
+
+static Truthiness truthiness_of(JV slf)
+{
+  int64_t slot = JLTypeOfAsTypeSlot(slf);
+  auto it = truthiness_of_type.find(slot);
+  if (it != truthiness_of_type.end())
+    return it->second;
+  Truthiness t = Truthiness::always;
+  if (JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_Number))
+    t = Truthiness::nonzero;
+  else if (JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_AbstractArray) ||
+           JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_AbstractDict) ||
+           JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_AbstractSet) ||
+           JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_AbstractString))
+    t = Truthiness::nonempty;
+  truthiness_of_type.emplace(slot, t);
+  return t;
 }
 
 static PyObject *jl_bool(PyObject *self, PyObject *args)
 {
+  EntryStatsScope stats(EntryPoint::bool_);
   //  1. check pyjv is a JV object, and unbox it as JV
   JV slf;
-  if (!PyCheck_Type_Exact(args, MyPyAPI.t_JV))
+  if (!PyCheck_JV(args))
   {
     PyErr_SetString(JuliaCallError, " expect object of JV class.");
     return NULL;
@@ -760,103 +982,436 @@ static PyObject *jl_bool(PyObject *self, PyObject *args)
   {
     slf = unbox_julia(args);
   }
-  // 2. check isa Number
-  PyObject *py;
-  if (JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_Number))
+  bool8_t result = true;
+  switch (truthiness_of(slf))
   {
-    JV jret;
-    JV jargs[2];
-    jargs[0] = slf;
-    jargs[1] = MyJLAPI.obj_zero;
-    ErrorCode ret;
-    ret = JLCall(&jret, MyJLAPI.f_ne, SList_adapt(jargs, 2), emptyKwArgs());
-    if (ret != ErrorCode::ok)
+  case Truthiness::nonzero:
+  {
+    stats.enter(StatsPhase::call);
+    if (JLCompare(&result, Compare::NE, slf, MyJLAPI.obj_zero) != ErrorCode::ok)
     {
       return HandleJLErrorAndReturnNULL();
     }
-    PyObject *py = reasonable_box(jret);
-    JLFreeFromMe(jret);
-    return py;
+    break;
   }
-  // 3.检查是不是抽象数组 抽象字典 抽象集合 抽象字符串
-  if (JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_AbstractArray) ||
-      JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_AbstractDict) ||
-      JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_AbstractSet) ||
-      JLIsInstanceWithTypeSlot(slf, MyJLAPI.t_AbstractString))
+  case Truthiness::nonempty:
   {
+    stats.enter(StatsPhase::call);
     JV jret;
-    ErrorCode ret;
-    ret = JLCall(&jret, MyJLAPI.f_isempty, SList_adapt(&slf, 1), emptyKwArgs());
-    if (ret != ErrorCode::ok)
+    if (JLCall(&jret, MyJLAPI.f_isempty, SList_adapt(&slf, 1), emptyKwArgs()) != ErrorCode::ok)
     {
       return HandleJLErrorAndReturnNULL();
     }
-    PyObject *py = reasonable_box(jret);
-    if (!PyCheck_Type_Exact(py, MyPyAPI.t_JV))
+    bool8_t empty;
+    ErrorCode ret = JLGetBool(&empty, jret, false);
+    JLFreeFromMe(jret);
+    if (ret != ErrorCode::ok)
     {
-      // if pyout is a JV object, we should not free it from Julia.
-      JLFreeFromMe(jret);
+      return HandleJLErrorAndReturnNULL();
     }
-    return py;
+    result = !empty;
+    break;
+  }
+  case Truthiness::always:
+    break;
   }
-  Py_INCREF(Py_True); // 增加引用计数，以防止被销毁
-  return Py_True;
+  stats.enter(StatsPhase::box);
+  return PyBool_FromLong(result);
 }
 
 static PyObject *jl_hash(PyObject *self, PyObject *arg)
 {
+  EntryStatsScope stats(EntryPoint::hash);
   // check pyjv is a JV object, and unbox it as JV
-  JV slf;
-  if (!PyCheck_Type_Exact(arg, MyPyAPI.t_JV))
+  if (!PyCheck_JV(arg))
   {
     PyErr_SetString(JuliaCallError, " expect object of JV class.");
     return NULL;
   }
+  t_JVSlot *slot = jv_slot_of(arg);
+  if (slot->hash_cached)
+  {
+    return PyLong_FromLongLong(slot->hash);
+  }
+
+  // call hash(v) % Int64
+  stats.enter(StatsPhase::call);
+  int64_t result;
+  bool8_t cacheable = false;
+  JV error = JV_NULL;
+  if (jlhash(&result, &cacheable, slot->jv, &error) != ErrorCode::ok)
+  {
+    if (error == JV_NULL)
+    {
+      PyErr_SetString(JuliaCallError, "hash: failed to hash the Julia object.");
+      return NULL;
+    }
+    return RaiseJLExceptionAndReturnNULL(error);
+  }
+  if (cacheable)
+  {
+    slot->hash = result;
+    slot->hash_cached = true;
+  }
+  stats.enter(StatsPhase::box);
+  return PyLong_FromLongLong(result);
+}
+
+static PyObject *jl_len(PyObject *self, PyObject *arg)
+{
+  EntryStatsScope stats(EntryPoint::len);
+  JV slf;
+  if (!PyCheck_JV(arg))
+  {
+    PyErr_SetString(JuliaCallError, "jl_len: expect object of JV class.");
+    return NULL;
+  }
   else
   {
     slf = unbox_julia(arg);
   }
 
-  // call hash(v)
+  stats.enter(StatsPhase::call);
   JV jret;
-  ErrorCode ret;
-  ret = JLCall(&jret, MyJLAPI.f_hash, SList_adapt(&slf, 1), emptyKwArgs());
-  // check if error occurs, if so, handle it and return NULL
+  ErrorCode ret = JLCall(&jret, MyJLAPI.f_length, SList_adapt(&slf, 1), emptyKwArgs());
   if (ret != ErrorCode::ok)
   {
     return HandleJLErrorAndReturnNULL();
   }
+  stats.enter(StatsPhase::box);
 
-  // call hash(v) % Int64
-  JV jret2;
-  JV jv_args[2];
-  jv_args[0] = jret;
-  jv_args[1] = MyJLAPI.obj_Int64;
-  ret = JLCall(&jret2, MyJLAPI.f_mod, SList_adapt(jv_args, 2), emptyKwArgs());
+  int64_t length;
+  ret = JLGetInt64(&length, jret, true);
+  JLFreeFromMe(jret);
+  if (ret != ErrorCode::ok)
+  {
+    return HandleJLErrorAndReturnNULL();
+  }
+  return PyLong_FromLongLong(length);
+}
+
+static PyObject *jl_mapping_getitem(PyObject *self, PyObject *args)
+{
+  EntryStatsScope stats(EntryPoint::mapping_getitem);
+  PyObject *pyjv, *key;
+  if (!PyArg_ParseTuple(args, "OO", &pyjv, &key))
+  {
+    return NULL;
+  }
+  JV slf;
+  if (!PyCheck_JV(pyjv))
+  {
+    PyErr_SetString(JuliaCallError, "jl_mapping_getitem: expect object of JV class.");
+    return NULL;
+  }
+  else
+  {
+    slf = unbox_julia(pyjv);
+  }
+
+  bool8_t needToBeFree = false;
+  JV v = reasonable_unbox(key, &needToBeFree);
+  if (v == JV_NULL)
+  {
+    return NULL;
+  }
+
+  // `get(d, k, KeyNotFound())` so that a miss costs no Julia exception
+  stats.enter(StatsPhase::call);
+  JV jret;
+  JV jargs[2] = {slf, v};
+  ErrorCode ret = JLCall(&jret, MyJLAPI.f_mapping_getitem, SList_adapt(jargs, 2), emptyKwArgs());
+  if (needToBeFree)
+    JLFreeFromMe(v);
 
   if (ret != ErrorCode::ok)
   {
-    JLFreeFromMe(jret);
     return HandleJLErrorAndReturnNULL();
   }
 
-  int64_t result;
-  if (ErrorCode::ok != JLGetInt64(&result, jret2, false))
+  if (JLIsInstanceWithTypeSlot(jret, MyJLAPI.t_KeyNotFound))
+  {
+    JLFreeFromMe(jret);
+    PyErr_SetObject(PyExc_KeyError, key);
+    return NULL;
+  }
+
+  stats.enter(StatsPhase::box);
+  PyObject *py = reasonable_box(jret);
+  if (!PyCheck_JV(py))
   {
+    // if pyout is a JV object, we should not free it from Julia.
     JLFreeFromMe(jret);
-    JLFreeFromMe(jret2);
+  }
+  return py;
+}
+
+static PyObject *jl_mapping_contains(PyObject *self, PyObject *args)
+{
+  EntryStatsScope stats(EntryPoint::mapping_contains);
+  PyObject *pyjv, *key;
+  if (!PyArg_ParseTuple(args, "OO", &pyjv, &key))
+  {
+    return NULL;
+  }
+  JV slf;
+  if (!PyCheck_JV(pyjv))
+  {
+    PyErr_SetString(JuliaCallError, "jl_mapping_contains: expect object of JV class.");
+    return NULL;
+  }
+  else
+  {
+    slf = unbox_julia(pyjv);
+  }
+
+  bool8_t needToBeFree = false;
+  JV v = reasonable_unbox(key, &needToBeFree);
+  if (v == JV_NULL)
+  {
+    return NULL;
+  }
+
+  stats.enter(StatsPhase::call);
+  JV jret;
+  JV jargs[2] = {slf, v};
+  ErrorCode ret = JLCall(&jret, MyJLAPI.f_mapping_haskey, SList_adapt(jargs, 2), emptyKwArgs());
+  if (needToBeFree)
+    JLFreeFromMe(v);
+
+  if (ret != ErrorCode::ok)
+  {
     return HandleJLErrorAndReturnNULL();
   }
-  PyObject *py = PyLong_FromLongLong(result);
+  stats.enter(StatsPhase::box);
 
-  // it's a julia's number, just free it
+  bool8_t out;
+  ret = JLGetBool(&out, jret, false);
   JLFreeFromMe(jret);
-  JLFreeFromMe(jret2);
+  if (ret != ErrorCode::ok)
+  {
+    return HandleJLErrorAndReturnNULL();
+  }
+
+  if (out)
+  {
+    Py_RETURN_TRUE;
+  }
+  else
+  {
+    Py_RETURN_FALSE;
+  }
+}
+
+static PyObject *jl_iter(PyObject *self, PyObject *args)
+{
+  EntryStatsScope stats(EntryPoint::iter);
+  // jl_iter(self: JV, kind: int), see IterKind
+  PyObject *pyjv;
+  long long kind;
+  if (!PyArg_ParseTuple(args, "OL", &pyjv, &kind))
+  {
+    return NULL;
+  }
+  JV slf;
+  if (!PyCheck_JV(pyjv))
+  {
+    PyErr_SetString(JuliaCallError, "jl_iter: expect object of JV class.");
+    return NULL;
+  }
+  else
+  {
+    slf = unbox_julia(pyjv);
+  }
+
+  stats.enter(StatsPhase::call);
+  JV jv_kind;
+  ToJLInt64(&jv_kind, kind);
+  JV stateful;
+  JV jargs[2] = {slf, jv_kind};
+  ErrorCode ret = JLCall(&stateful, MyJLAPI.f_chunked_iterator, SList_adapt(jargs, 2), emptyKwArgs());
+  JLFreeFromMe(jv_kind);
+  if (ret != ErrorCode::ok)
+  {
+    return HandleJLErrorAndReturnNULL();
+  }
+  stats.enter(StatsPhase::box);
+  return JVIterator_New(stateful);
+}
+
+static PyObject *jl_stats(PyObject *self, PyObject *args)
+{
+  return EntryStats_ToPy();
+}
+
+static PyObject *jl_reset_stats(PyObject *self, PyObject *args)
+{
+  EntryStats_Reset();
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *jl_set_sampling(PyObject *self, PyObject *args)
+{
+  // jl_set_sampling(every: int, sink: callable | None, skip_prefixes: tuple[str, ...])
+  unsigned long long every;
+  PyObject *sink, *skip_prefixes;
+  if (!PyArg_ParseTuple(args, "KOO", &every, &sink, &skip_prefixes))
+  {
+    return NULL;
+  }
+  return EntryStats_SetSampling(every, sink, skip_prefixes);
+}
+
+static PyObject *jl_live_handles(PyObject *self, PyObject *args)
+{
+  return PyLong_FromLongLong(jv_live_count);
+}
+
+static PyObject *jl_pending_releases(PyObject *self, PyObject *args)
+{
+  return PyLong_FromLongLong(release_size);
+}
+
+static PyObject *jl_flush_releases(PyObject *self, PyObject *args)
+{
+  ReleaseQueue_Enter();
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *jl_set_handle_tracking(PyObject *self, PyObject *args)
+{
+  // jl_set_handle_tracking(on: bool, capture: callable | None)
+  int on;
+  PyObject *capture;
+  if (!PyArg_ParseTuple(args, "pO", &on, &capture))
+  {
+    return NULL;
+  }
+  HandleRegistry_SetTracking(on, capture);
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *jl_handle_snapshot(PyObject *self, PyObject *args)
+{
+  return HandleRegistry_Snapshot();
+}
+
+static PyObject *jl_set_box_cache(PyObject *self, PyObject *args)
+{
+  // jl_set_box_cache(identity: int)
+  // identity is the address of a `uint64_t (*)(JV)` function, or 0 to turn the cache off
+  unsigned long long identity;
+  if (!PyArg_ParseTuple(args, "K", &identity))
+  {
+    return NULL;
+  }
+  BoxCache_Set((t_jlboxidentity)(uintptr_t)identity);
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *jl_no_convert(PyObject *self, PyObject *args)
+{
+  // jl_no_convert(delta: int) -> int, enters (1) or leaves (-1) a `no_convert` scope
+  long long delta;
+  if (!PyArg_ParseTuple(args, "L", &delta))
+  {
+    return NULL;
+  }
+  no_convert_depth += delta;
+  return PyLong_FromLongLong(no_convert_depth);
+}
+
+static PyObject *jl_raw_handle(PyObject *self, PyObject *pyjv)
+{
+  // a new JV of the same Julia object whose calls return JVs
+  if (!PyCheck_JV(pyjv))
+  {
+    PyErr_SetString(JuliaCallError, "jl_raw_handle: expect object of JV class.");
+    return NULL;
+  }
+  JV slf = unbox_julia(pyjv);
+  JV out;
+  if (JLCall(&out, MyJLAPI.f_identity, SList_adapt(&slf, 1), emptyKwArgs()) != ErrorCode::ok)
+  {
+    return HandleJLErrorAndReturnNULL();
+  }
+  // not shared through the box cache, the flag belongs to this JV only
+  PyObject *py = box_julia_new(out, 0);
+  if (py == NULL)
+  {
+    JLFreeFromMe(out);
+    return NULL;
+  }
+  jv_slot_of(py)->raw = true;
   return py;
 }
 
+static PyObject *jl_set_backtraces(PyObject *self, PyObject *args)
+{
+  // jl_set_backtraces(on: bool) -> bool, the previous setting
+  int on;
+  if (!PyArg_ParseTuple(args, "p", &on))
+  {
+    return NULL;
+  }
+  bool8_t was = JLError_HasBackTraceMsg();
+  JLError_EnableBackTraceMsg(on);
+  return PyBool_FromLong(was);
+}
+
+static PyObject *jl_set_gc_accounting(PyObject *self, PyObject *args)
+{
+  // jl_set_gc_accounting(snapshot: int, annotate: bool)
+  // snapshot is the address of a `void (*)(int64_t *)` function, or 0 to turn accounting off
+  unsigned long long snapshot;
+  int annotate;
+  if (!PyArg_ParseTuple(args, "Kp", &snapshot, &annotate))
+  {
+    return NULL;
+  }
+  gc_snapshot = (t_jlgcsnapshot)(uintptr_t)snapshot;
+  gc_annotate = snapshot != 0 && annotate;
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *jl_start_trace(PyObject *self, PyObject *args)
+{
+  // jl_start_trace(capacity: int, gc_clock: int, compile_clock: int)
+  // the clocks are addresses of `uint64_t (*)(void)` functions, or 0
+  unsigned long long capacity, gc_clock, compile_clock;
+  if (!PyArg_ParseTuple(args, "KKK", &capacity, &gc_clock, &compile_clock))
+  {
+    return NULL;
+  }
+  if (capacity == 0)
+  {
+    PyErr_SetString(PyExc_ValueError, "trace capacity must be positive");
+    return NULL;
+  }
+  if (Trace_Start(capacity, (t_jlclock)(uintptr_t)gc_clock, (t_jlclock)(uintptr_t)compile_clock) != 0)
+  {
+    return NULL;
+  }
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *jl_stop_trace(PyObject *self, PyObject *args)
+{
+  // returns the events still in the buffer
+  PyObject *events = Trace_Drain(ENTRY_POINT_NAMES);
+  Trace_Stop();
+  return events;
+}
+
 static PyMethodDef jl_methods[] = {
     {"__jl_invoke__", jl_call, METH_VARARGS, "call JV as callable object"},
+    {"__jl_invoke_raw__", jl_call_raw, METH_VARARGS, "call JV and return the result as a JV"},
     {"__jl_repr__", jl_display, METH_O, "display JV as string"},
     {"_jl_repr_pretty_", jl_repr_pretty, METH_O, "display JV as string"},
     {"__jl_getattr__", jl_getattr, METH_VARARGS, "get attr of JV object"},
@@ -890,6 +1445,26 @@ static PyMethodDef jl_methods[] = {
     {"__jl_abs__", jl_abs, METH_O, "abs function"},
     {"__jl_bool__", jl_bool, METH_O, "bool function"},
     {"__jl_hash__", jl_hash, METH_O, "hash function"},
+    {"__jl_len__", jl_len, METH_O, "length of JV object"},
+    {"__jl_mapping_getitem__", jl_mapping_getitem, METH_VARARGS, "get value of a Julia mapping, raise KeyError on miss"},
+    {"__jl_mapping_contains__", jl_mapping_contains, METH_VARARGS, "check if a Julia mapping has the key"},
+    {"__jl_iter__", jl_iter, METH_VARARGS, "iterate JV object in chunks"},
+    {"__jl_set_recording__", jl_set_recording, METH_O, "turn call signature recording on or off, return the previous state"},
+    {"__jl_stats__", jl_stats, METH_NOARGS, "call counts and latency histograms of the entry points"},
+    {"__jl_reset_stats__", jl_reset_stats, METH_NOARGS, "reset the entry point statistics"},
+    {"__jl_set_sampling__", jl_set_sampling, METH_VARARGS, "report every n-th crossing with its call site to a Python callable"},
+    {"__jl_live_handles__", jl_live_handles, METH_NOARGS, "number of JV handles owned by Python objects"},
+    {"__jl_pending_releases__", jl_pending_releases, METH_NOARGS, "number of released JV handles not yet freed in Julia"},
+    {"__jl_flush_releases__", jl_flush_releases, METH_NOARGS, "free the released JV handles now"},
+    {"__jl_set_handle_tracking__", jl_set_handle_tracking, METH_VARARGS, "record the type and allocation site of every JV boxed"},
+    {"__jl_handle_snapshot__", jl_handle_snapshot, METH_NOARGS, "the live JV handles recorded while tracking"},
+    {"__jl_set_box_cache__", jl_set_box_cache, METH_VARARGS, "box a live mutable Julia object to the same JV"},
+    {"__jl_no_convert__", jl_no_convert, METH_VARARGS, "enter or leave a scope returning JVs unconverted"},
+    {"__jl_raw_handle__", jl_raw_handle, METH_O, "a new JV whose calls return JVs unconverted"},
+    {"__jl_set_backtraces__", jl_set_backtraces, METH_VARARGS, "format the Julia backtrace into the message of Julia errors"},
+    {"__jl_set_gc_accounting__", jl_set_gc_accounting, METH_VARARGS, "attribute Julia allocations and GC time to the calls"},
+    {"__jl_start_trace__", jl_start_trace, METH_VARARGS, "record entry point spans into a ring buffer"},
+    {"__jl_stop_trace__", jl_stop_trace, METH_NOARGS, "stop tracing and return the recorded spans"},
     {NULL, NULL, 0, NULL}};
 
 static PyObject *setup_api(PyObject *self, PyObject *args)
@@ -904,9 +1479,16 @@ static PyObject *setup_api(PyObject *self, PyObject *args)
 
   if (MyPyAPI.t_JV == NULL)
   {
+    if (init_JLAPI() != 0)
+    {
+      return NULL;
+    }
     Py_IncRef(cls_jv); // Py_IncRef 函数用于增加 Python 对象的引用计数。
-    init_JLAPI();
-    init_PyAPI(cls_jv); // 自定义函数或库初始化函数的调用。
+    init_PyAPI(cls_jv, m_jv); // 自定义函数或库初始化函数的调用。
+    if (init_JVIterator() != 0)
+    {
+      return NULL;
+    }
     PyModule_AddFunctions(m_jv, jl_methods);
   }
 
@@ -931,7 +1513,7 @@ static PyMethodDef methods[] = {
     {"setup_api", setup_api, METH_VARARGS,
      "setup JV class and init MyPyAPI/MyJLAPI"},
     {"evaluate", jl_eval, METH_VARARGS,
-     "eval julia function and return a python capsule"},
+     "evaluate julia code in a module (Main by default)"},
     {"setup_basics", setup_basics, METH_O,
      "setup JV module Base and Main in python module"},
     {NULL, NULL, 0, NULL}};
@@ -942,8 +1524,15 @@ static struct PyModuleDef juliacall_module = {
 DLLEXPORT PyObject *init_PyModule(void)
 {
   name_jlslot = PyUnicode_FromString("__jlslot__");
+  name_jlalloc = PyUnicode_FromString("__jlalloc__");
   JuliaCallError = PyErr_NewException("_tyjuliacall_jnumpy.error", NULL, NULL);
   PyObject *m = PyModule_Create(&juliacall_module);
+  Py_IncRef(JuliaCallError);
+  PyModule_AddObject(m, "error", JuliaCallError);
+  if (init_JLErrorClasses(m) != 0)
+  {
+    return NULL;
+  }
   PyObject *sys = PyImport_ImportModule("sys");
   PyObject *sys_module = PyObject_GetAttrString(sys, "modules");
   Py_IncRef(m);
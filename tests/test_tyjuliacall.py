@@ -186,3 +186,560 @@ def test_all():
         JuliaEvaluator[1, 2]
     except TypeError:
         pass
+
+
+def test_containers():
+    from collections.abc import Mapping, Sequence
+    from tyjuliacall import JV, JuliaEvaluator
+
+    d = JuliaEvaluator["Dict(string(i) => i for i in 1:1000)"]
+    assert isinstance(d, JV) and isinstance(d, Mapping)
+    assert len(d) == 1000
+    assert d["10"] == 10
+    assert "10" in d and "1001" not in d
+    assert d.get("1001", -1) == -1
+    try:
+        d["1001"]
+        assert False
+    except KeyError:
+        pass
+    assert sorted(d.keys()) == sorted(str(i) for i in range(1, 1001))
+    assert sorted(d.values()) == list(range(1, 1001))
+    assert dict(d.items()) == {str(i): i for i in range(1, 1001)}
+
+    nt = JuliaEvaluator["(a = 1, b = \"2\")"]
+    assert isinstance(nt, Mapping)
+    assert list(nt) == ["a", "b"]
+    assert nt["b"] == "2"
+    assert dict(nt) == {"a": 1, "b": "2"}
+    # the Mapping methods shadow Julia fields of the same name, which stay reachable by key
+    nt = JuliaEvaluator["(values = 1, keys = 2, other = 3)"]
+    assert sorted(nt.values()) == [1, 2, 3]
+    assert list(nt.keys()) == ["values", "keys", "other"]
+    assert nt["values"] == 1 and nt["keys"] == 2
+    assert nt.other == 3
+
+    xs = JuliaEvaluator['Any[1, "2", 3.0]']
+    # 1-based, so it does not claim Python's sequence semantics
+    assert not isinstance(xs, Sequence)
+    assert len(xs) == 3
+    assert list(xs) == [1, "2", 3.0]
+    assert list(reversed(xs)) == [3.0, "2", 1]
+    assert xs[1] == 1 and xs.index("2") == 2 and xs.count(1) == 1
+
+
+def test_iterate_lazy():
+    from tyjuliacall import JuliaEvaluator
+
+    ch = JuliaEvaluator["let c = Channel{Int}(10); foreach(i -> put!(c, i), 1:5); close(c); c end"]
+    for x in ch:
+        if x == 2:
+            break
+    # nothing was taken from the channel beyond what the loop consumed
+    assert list(ch) == [3, 4, 5]
+
+    JuliaEvaluator["lazy_seen = Int[]"]
+    it = iter(JuliaEvaluator["(push!(lazy_seen, i)[end] for i in 1:1000)"])
+    assert next(it) == 1 and next(it) == 2
+    assert JuliaEvaluator["length(lazy_seen)"] == 2
+
+
+def test_iterate_error():
+    import pytest
+    from tyjuliacall import JuliaEvaluator
+
+    # the Julia exception reaches Python with its message and error class
+    with pytest.raises(ValueError, match="lazy boom"):
+        list(JuliaEvaluator["(i < 3 ? i : throw(ArgumentError(\"lazy boom\")) for i in 1:5)"])
+
+    # elements fetched in the same chunk before the failure are handed out first
+    JuliaEvaluator["""
+    struct BoomVector <: AbstractVector{Any} end
+    Base.size(::BoomVector) = (5,)
+    Base.getindex(::BoomVector, i::Int) = i < 4 ? i : error("chunk boom")
+    """]
+    it = iter(JuliaEvaluator["BoomVector()"])
+    assert [next(it), next(it), next(it)] == [1, 2, 3]
+    with pytest.raises(Exception, match="chunk boom"):
+        next(it)
+    assert list(it) == []
+
+
+def test_iterate():
+    from tyjuliacall import JuliaEvaluator
+
+    r = JuliaEvaluator["1:10_000"]
+    assert list(r) == list(range(1, 10_001))
+    assert sum(JuliaEvaluator["(x * 0.5 for x in 1:1000)"]) == 250250.0
+    assert sorted(JuliaEvaluator["Set([1, 2, 3])"]) == [1, 2, 3]
+    assert list(JuliaEvaluator["BitArray([1, 0])"]) == [True, False]
+    assert list(JuliaEvaluator["(Symbol(:a, i) for i in 1:300)"])[-1] is not None
+    assert list(JuliaEvaluator["1:0"]) == []
+
+
+def test_tuples():
+    from tyjuliacall import JV, JuliaEvaluator
+
+    t = JuliaEvaluator["(1.0, 2.0, 3.0)"]
+    assert t == (1.0, 2.0, 3.0) and all(isinstance(x, float) for x in t)
+    t = JuliaEvaluator["(Int32(1), true, 1.5f0)"]
+    assert t == (1, True, 1.5) and t[1] is True
+    t = JuliaEvaluator["Tuple(1:100)"]
+    assert t == tuple(range(1, 101))
+    x, residual, iters, msg = JuliaEvaluator['([1.0, 2.0], 1e-8, 12, :converged)']
+    assert list(x) == [1.0, 2.0] and residual == 1e-8 and iters == 12
+    assert isinstance(msg, JV)
+    assert JuliaEvaluator["()"] == ()
+
+
+def test_buffers():
+    import array
+    from tyjuliacall import JuliaEvaluator
+
+    is_bytes = JuliaEvaluator["x -> x isa Vector{UInt8}"]
+    assert is_bytes(b"abc") and is_bytes(bytearray(b"abc")) and is_bytes(memoryview(b"abc"))
+    assert JuliaEvaluator["x -> String(copy(x))"](b"\xe6\xb5\x8b") == "测"
+
+    buf = bytearray(b"abc")
+    JuliaEvaluator["x -> (x[1] = UInt8('z'); nothing)"](buf)
+    assert buf == bytearray(b"zbc")
+
+    data = b"abc"
+    JuliaEvaluator["x -> (x[1] = UInt8('z'); nothing)"](memoryview(data))
+    assert data == b"abc"
+
+    xs = array.array("d", [1.0, 2.0])
+    JuliaEvaluator["x -> (x[2] = 3.0; nothing)"](xs)
+    assert xs[1] == 3.0
+
+
+def test_numpy_scalars():
+    import numpy as np
+    from tyjuliacall import JuliaEvaluator
+
+    typeof = JuliaEvaluator["x -> string(typeof(x))"]
+    assert typeof(np.float32(1.5)) == "Float32"
+    assert typeof(np.int8(3)) == "Int8"
+    assert typeof(np.uint64(3)) == "UInt64"
+    assert typeof(np.bool_(True)) == "Bool"
+    assert typeof(np.complex64(1 + 2j)) == "ComplexF32"
+    assert typeof(np.str_("abc")) == "String"
+    assert JuliaEvaluator["x -> x == 1.5f0"](np.float32(1.5))
+    assert JuliaEvaluator["x -> x == 2.0 + 3.0im"](np.complex128(2 + 3j))
+
+    assert JuliaEvaluator["x -> string(x) == \"2020-01-02T03:00:00\""](np.datetime64("2020-01-02T03:00"))
+    assert JuliaEvaluator["x -> string(x) == \"5 seconds\""](np.timedelta64(5, "s"))
+    assert JuliaEvaluator["x -> x === missing"](np.datetime64("NaT"))
+
+
+def test_discovery_cache(tmp_path, monkeypatch):
+    import shutil
+    import pytest
+    import tyjuliasetup
+
+    monkeypatch.setenv("TYPY_CACHE_DIR", str(tmp_path))
+    jl_exe = shutil.which("julia")
+    found = tyjuliasetup.get_sysimage_and_projdir(jl_exe)
+    assert len(list(tmp_path.glob("discovery-*.json"))) == 1
+    assert tyjuliasetup.JULIA_VERSION
+
+    def no_julia(*args, **kwargs):
+        raise AssertionError("julia should not be invoked on a cache hit")
+
+    monkeypatch.setattr(tyjuliasetup, "invoke_julia", no_julia)
+    assert tyjuliasetup.get_sysimage_and_projdir(jl_exe) == found
+
+    # a different environment is a different key
+    monkeypatch.setenv("JULIA_LOAD_PATH", "@:@stdlib")
+    with pytest.raises(AssertionError):
+        tyjuliasetup.get_sysimage_and_projdir(jl_exe)
+
+
+def _julia_sum(xs):
+    import os
+    from tyjuliacall import JuliaEvaluator
+
+    return os.getpid(), JuliaEvaluator["sum"](xs)
+
+
+def test_forkserver(tmp_path):
+    import os
+    import time
+    import pytest
+
+    if not hasattr(os, "fork"):
+        pytest.skip("fork() is not available")
+    from tyjuliacall import forkserver
+
+    pid, s = forkserver.fork_worker(_julia_sum, ([1, 2, 3],)).result()
+    assert pid != os.getpid() and s == 6
+
+    with pytest.raises(ZeroDivisionError):
+        forkserver.fork_worker(lambda: 1 // 0).result()
+
+    address = str(tmp_path / "jl.sock")
+    server_pid = os.fork()
+    if server_pid == 0:
+        try:
+            forkserver._after_fork_child()
+            forkserver.ForkServer(address).serve_forever()
+        finally:
+            os._exit(1)
+    try:
+        while not os.path.exists(address):
+            time.sleep(0.05)
+        pid, s = forkserver.call(address, _julia_sum, [4, 5])
+        assert pid not in (os.getpid(), server_pid) and s == 9
+    finally:
+        os.kill(server_pid, 9)
+        os.waitpid(server_pid, 0)
+
+
+def test_record_precompiles(tmp_path):
+    import numpy as np
+    from tyjuliacall import JuliaEvaluator
+    from tyjuliasetup import record_precompiles
+
+    trace = tmp_path / "precompiles.jl"
+    with record_precompiles(trace):
+        JuliaEvaluator["sum"](np.array([1, 2]))
+        JuliaEvaluator["(x; init) -> x + init"](1, init=2)
+    lines = trace.read_text().splitlines()
+    assert any(line.startswith("precompile(Tuple{typeof(sum),") for line in lines)
+    assert all(line.startswith("precompile(") for line in lines)
+
+    # merged into the existing file, not recorded outside of the block
+    JuliaEvaluator["prod"](np.array([1, 2]))
+    with record_precompiles(trace):
+        JuliaEvaluator["maximum"](np.array([1, 2]))
+    text = trace.read_text()
+    assert "typeof(sum)" in text and "typeof(maximum)" in text and "typeof(prod)" not in text
+
+
+def test_startup_profile():
+    import tyjuliacall  # noqa: F401
+    from tyjuliasetup import startup_profile
+
+    phases = startup_profile()
+    names = [phase.name for phase in phases]
+    for name in ["init_libjulia", "TyJuliaSetup.init", "boot: dlopen libjuliacall", "setup_api", "init_JLAPI"]:
+        assert name in names
+    assert names.index("boot: dlopen libjuliacall") > names.index("TyJuliaSetup.init")
+    assert all(phase.seconds >= 0 for phase in phases)
+    init = phases[names.index("TyJuliaSetup.init")]
+    assert init.parent == "PyJulia-Core" and init.julia_allocated_bytes > 0
+
+
+def test_stats():
+    import numpy as np
+    from tyjuliacall import JuliaEvaluator, stats, reset_stats
+
+    f = JuliaEvaluator["x -> x"]
+    reset_stats()
+    for _ in range(3):
+        f(np.ones(3))
+    try:
+        JuliaEvaluator["error"]("e")
+    except Exception:
+        pass
+    call = stats()["call"]
+    assert call["count"] == 4 and call["errors"] == 1
+    # the failed call never reaches the box phase
+    assert sum(call["unbox"]["histogram"]) == sum(call["call"]["histogram"]) == 4
+    assert sum(call["box"]["histogram"]) == 3
+    assert call["call"]["total_ns"] > 0
+
+    reset_stats()
+    assert "call" not in stats()
+
+
+def test_sampling():
+    import numpy as np
+    from tyjuliacall import JuliaEvaluator
+    from tyjuliasetup import start_sampling, stop_sampling, reset_sampling, sampling_report
+
+    f = JuliaEvaluator["sum"]
+    xs = np.ones(10)
+    reset_sampling()
+    start_sampling()
+    try:
+        for _ in range(5):
+            f(xs)  # the call site
+    finally:
+        stop_sampling()
+    sites = [site for site in sampling_report() if site.entry == "call"]
+    assert sites[0].samples == 5 and sites[0].julia == "sum"
+    assert sites[0].filename.endswith("test_tyjuliacall.py") and sites[0].lineno is not None
+
+    f(xs)
+    assert sampling_report()[0].samples == 5
+    reset_sampling()
+    assert sampling_report() == []
+
+
+def test_trace(tmp_path):
+    import json
+    from tyjuliacall import JuliaEvaluator
+    from tyjuliasetup import start_trace, stop_trace, trace_span
+
+    f = JuliaEvaluator["x -> x + 1"]
+    start_trace(capacity=4)
+    with trace_span("request"):
+        for i in range(10):
+            f(i)
+    path = tmp_path / "trace.json"
+    events = stop_trace(path)
+    calls = [e for e in events if e.get("name") == "call" and e.get("cat") == "crossing"]
+    # only the last `capacity` crossings are kept
+    assert len(calls) == 4
+    phases = [e["name"] for e in events if e.get("cat") == "phase"]
+    assert phases.count("unbox") == phases.count("call") == phases.count("box") == 4
+    assert any(e.get("name") == "request" for e in events)
+    assert json.loads(path.read_text())["traceEvents"] == events
+
+    f(1)
+    assert stop_trace() == [e for e in events if e["ph"] == "M"]
+
+
+def test_enable_perf_map_after_init():
+    import pytest
+    from tyjuliasetup import enable_perf_map
+
+    with pytest.raises(RuntimeError):
+        enable_perf_map()
+
+
+def test_gc_accounting():
+    from tyjuliacall import JuliaEvaluator
+    from tyjuliasetup import start_gc_accounting, stop_gc_accounting, julia_allocations, stats, reset_stats
+
+    f = JuliaEvaluator["n -> [zeros(n)]"]
+    g = JuliaEvaluator["n -> n + 1"]
+    f(1)
+    reset_stats()
+    start_gc_accounting(annotate=True)
+    try:
+        xs = f(1000)
+        assert g(1) == 2
+    finally:
+        stop_gc_accounting()
+    allocations = julia_allocations(xs)
+    assert allocations.bytes >= 8000 and allocations.allocs >= 2
+    assert stats()["call"]["julia"]["bytes"] >= allocations.bytes
+
+    assert julia_allocations(f(1000)) is None
+    assert julia_allocations(1) is None
+
+
+def test_handle_registry():
+    from tyjuliacall import JuliaEvaluator
+    from tyjuliasetup import start_handle_tracking, stop_handle_tracking, handle_snapshot, live_handles
+
+    f = JuliaEvaluator["n -> Ref(n)"]
+    start_handle_tracking(backtraces=True)
+    try:
+        before = handle_snapshot()
+        n = live_handles()
+        refs = [f(i) for i in range(3)]
+        assert live_handles() == n + 3
+        after = handle_snapshot()
+        (group,) = after.diff(before)
+        assert group.count == 3 and group.type.startswith("Base.RefValue")
+        assert group.site[0][0].endswith("test_tyjuliacall.py")
+        assert after.by_type()[group.type] == 3
+
+        del refs
+        assert live_handles() == n
+        assert handle_snapshot().diff(before) == []
+    finally:
+        stop_handle_tracking()
+
+    v = JuliaEvaluator["Any[1, 2]"]
+    assert v.__setitem__(1, 3) is None and v[1] == 3
+
+
+def test_release_queue():
+    from tyjuliacall import JuliaEvaluator
+    from tyjuliasetup import live_handles, pending_releases, flush_releases
+
+    f = JuliaEvaluator["n -> Ref(n)"]
+    flush_releases()
+    refs = [f(i) for i in range(100)]
+    n = live_handles()
+    del refs
+    assert live_handles() == n - 100
+    assert pending_releases() == 100
+    # the next crossing frees them in one batch
+    x = f(0)
+    assert pending_releases() == 0
+
+
+def test_box_cache():
+    from tyjuliacall import JuliaEvaluator
+    from tyjuliasetup import enable_box_cache
+
+    JuliaEvaluator["const _box_cache_ref = Ref(1)"]
+    get = JuliaEvaluator["() -> _box_cache_ref"]
+    assert get() is not get()
+    enable_box_cache()
+    try:
+        x = get()
+        assert get() is x
+        del x
+        assert get() is not None
+    finally:
+        enable_box_cache(False)
+    assert get() is not get()
+
+
+def test_hash_cache():
+    import pytest
+    from tyjuliacall import JuliaEvaluator
+    from tyjuliasetup import stats, reset_stats
+
+    x = JuliaEvaluator["Some(1)"]
+    # `__hash__` gives Julia's Int64, which `hash()` reduces like any Python int
+    julia_hash = int(JuliaEvaluator["hash(Some(1)) % Int64"])
+    reset_stats()
+    assert hash(x) == hash(x) == hash(x) == hash(julia_hash)
+    # immutable: computed once, then read from the JV
+    assert stats()["hash"]["count"] == 3
+    assert sum(stats()["hash"]["call"]["histogram"]) == 1
+    assert x.__hash__() == julia_hash
+    assert {x: 1}[x] == 1
+    y = JuliaEvaluator["Some(1)"]
+    assert y is not x and hash(y) == hash(x)
+    assert {x: 1}[y] == 1
+
+    v = JuliaEvaluator["Any[1]"]
+    h = hash(v)
+    v[1] = 2
+    assert hash(v) != h
+
+    # a failing `hash` runs once and raises its own Julia error
+    JuliaEvaluator["""
+    struct HashBoom end
+    const hash_calls = Ref(0)
+    Base.hash(::HashBoom, h::UInt) = (hash_calls[] += 1; throw(ArgumentError("hash boom")))
+    """]
+    with pytest.raises(ValueError, match="hash boom"):
+        hash(JuliaEvaluator["HashBoom()"])
+    assert JuliaEvaluator["hash_calls[]"] == 1
+
+
+def test_compare_and_bool():
+    from tyjuliacall import JuliaEvaluator
+
+    assert not JuliaEvaluator["Any[]"]
+    assert JuliaEvaluator["Any[1]"]
+    assert not JuliaEvaluator["Dict{Any, Any}()"]
+    assert JuliaEvaluator["Some(nothing)"]
+    # the strategy cached for Vector{Any} keeps reading each value
+    assert not JuliaEvaluator["Any[]"]
+
+    a = JuliaEvaluator["v\"1.0\""]
+    b = JuliaEvaluator["v\"1.1\""]
+    assert (a < b) is True and (a >= b) is False
+    assert (JuliaEvaluator["Some(1)"] == JuliaEvaluator["Some(1)"]) is True
+    # not a Bool: falls back to calling `==`
+    r = JuliaEvaluator["missing"] == JuliaEvaluator["Some(1)"]
+    assert r is None or not isinstance(r, bool)
+
+
+def test_typed_julia_errors():
+    import pytest
+    from tyjuliacall import JuliaEvaluator, JuliaCallError
+
+    v = JuliaEvaluator["Any[1]"]
+    with pytest.raises(IndexError) as e:
+        v[5]
+    assert isinstance(e.value, JuliaCallError)
+    assert "BoundsError" in str(e.value)
+    with pytest.raises(KeyError):
+        JuliaEvaluator["d -> d[:missing_key]"](JuliaEvaluator["Dict{Symbol, Int}()"])
+    with pytest.raises(ZeroDivisionError):
+        JuliaEvaluator["div"](1, 0)
+    with pytest.raises(JuliaCallError) as e:
+        JuliaEvaluator["() -> error(\"plain\")"]()
+    assert type(e.value) is JuliaCallError
+
+
+def test_no_convert():
+    import numpy as np
+    from tyjuliacall import JuliaEvaluator, JV, no_convert
+
+    ones = JuliaEvaluator["ones"]
+    assert isinstance(ones(3), np.ndarray)
+    x = ones.raw(3)
+    assert isinstance(x, JV)
+    assert JuliaEvaluator["sum"](x) == 3.0
+    assert JuliaEvaluator["println"].raw("") is None
+
+    with no_convert():
+        y = ones(2, 2)
+        t = JuliaEvaluator["(1, 2)"]
+        assert isinstance(y, JV) and isinstance(t, JV)
+        assert isinstance(y[1, 1], JV)
+    assert isinstance(ones(3), np.ndarray)
+
+    raw_ones = no_convert(ones)
+    assert isinstance(raw_ones(3), JV)
+    assert isinstance(ones(3), np.ndarray)
+
+
+def test_module_attribute_cache():
+    from tyjuliacall import JuliaEvaluator
+    from tyjuliasetup import JuliaModule, JuliaLoader, stats, reset_stats
+
+    JuliaEvaluator["const cached_f = sum; cached_g = 1"]
+    m = JuliaModule(JuliaLoader, "tyjuliacall.Main", JuliaEvaluator["Main"])
+    f = m.cached_f
+    assert m.cached_g == 1
+    reset_stats()
+    assert m.cached_f is f
+    assert m.cached_g == 1
+    # the constant comes from the cache, the global variable is looked up again
+    assert stats()["getattr"]["count"] == 1
+    JuliaEvaluator["cached_g = 2"]
+    assert m.cached_g == 2
+    assert "cached_f" in dir(m)
+
+
+def test_evaluate_cache():
+    from tyjuliacall import JuliaEvaluator, clear_evaluate_cache
+
+    is_int = JuliaEvaluator["x -> typeof(x) == Int"]
+    assert is_int(1) and not is_int(1.0)
+    # an anonymous function is created once per source text
+    assert JuliaEvaluator["x -> typeof(x) == Int"] == is_int
+    JuliaEvaluator["evaluate_counter = 0"]
+    for _ in range(3):
+        JuliaEvaluator["global evaluate_counter += 1; evaluate_counter"]
+    assert JuliaEvaluator["evaluate_counter"] == 3
+    assert JuliaEvaluator["a_ = 1\nb_ = 2\na_ + b_"] == 3
+    clear_evaluate_cache()
+    assert JuliaEvaluator["x -> typeof(x) == Int"] != is_int
+
+
+def test_evaluate_in_module():
+    import pytest
+    from tyjuliacall import JuliaEvaluator, julia_backtraces
+
+    M = JuliaEvaluator["module EvalTarget end"]
+    assert JuliaEvaluator.evaluate("x = 1\ny = x + 1\ny", M) == 2
+    assert JuliaEvaluator["EvalTarget.y"] == 2
+    with pytest.raises(NameError):
+        JuliaEvaluator["y_only_in_eval_target"]
+    JuliaEvaluator.evaluate("located() = 1", M, "templates/gen.jl", 40)
+    where = JuliaEvaluator["m -> (f = first(methods(m.located)); (String(f.file), f.line))"](M)
+    assert where == ("templates/gen.jl", 40)
+    assert JuliaEvaluator.evaluate("(@__FILE__, @__LINE__)", M, "gen.jl", 10) == ("gen.jl", 10)
+    assert JuliaEvaluator.evaluate("\n@__LINE__", M, "gen.jl", 10) == 11
+    previous = julia_backtraces(True)
+    try:
+        with pytest.raises(Exception) as e:
+            JuliaEvaluator.evaluate("\n\nerror(\"boom\")", M, "gen.jl", 1)
+    finally:
+        julia_backtraces(previous)
+    assert "boom" in str(e.value)
+    assert "gen.jl:3" in str(e.value)
@@ -4,4 +4,8 @@ from tyjuliasetup import _load_pyjulia_core
 setup()
 
 JV = _load_pyjulia_core().JV
+if hasattr(_load_pyjulia_core(), "error"):
+    # base class of the Julia errors, which also derive from IndexError, KeyError etc.;
+    # the pycall backend raises its own errors and has no such class
+    JuliaCallError = _load_pyjulia_core().error
 sys.meta_path.insert(0, JuliaFinder())  # type: ignore
@@ -0,0 +1,222 @@
+"""
+Pre-fork warm workers: initialize Python, Julia and libjuliacall once in a
+server process, then `fork()` workers that are ready to call Julia at once.
+
+    # server, e.g. `python -m tyjuliacall.forkserver /tmp/jl.sock --preload LinearAlgebra`
+    forkserver.ForkServer("/tmp/jl.sock", packages=["LinearAlgebra"]).serve_forever()
+
+    # client, any Python process
+    forkserver.call("/tmp/jl.sock", mymodule.job, *args)
+
+`fork()` only copies the calling thread, so the server requires Julia to run
+with a single thread and no parallel GC threads (`JULIA_NUM_THREADS=1`).
+Only POSIX systems are supported.
+"""
+from __future__ import annotations
+import os
+import pickle
+import signal
+import socket
+import struct
+import sys
+import threading
+import typing
+from tyjuliacall import JuliaEvaluator
+
+__all__ = ["ForkServer", "Worker", "fork_worker", "call", "preload"]
+
+_HEADER = struct.Struct("!Q")
+
+def _send(sock: socket.socket, obj):
+    data = pickle.dumps(obj)
+    sock.sendall(_HEADER.pack(len(data)) + data)
+
+
+def _recv_exact(sock: socket.socket, n: int) -> bytes:
+    buf = bytearray()
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            raise EOFError("forkserver: connection closed")
+        buf += chunk
+    return bytes(buf)
+
+
+def _recv(sock: socket.socket):
+    (n,) = _HEADER.unpack(_recv_exact(sock, _HEADER.size))
+    return pickle.loads(_recv_exact(sock, n))
+
+
+def _check_forkable():
+    if not hasattr(os, "fork"):
+        raise OSError("forkserver requires fork(), which is not available on this platform")
+    if threading.current_thread() is not threading.main_thread():
+        raise RuntimeError("forkserver: workers must be forked from the main thread")
+    issue = JuliaEvaluator["TyJuliaSetup.fork_safety_issue"]()
+    if issue is not None:
+        raise RuntimeError("forkserver: {}".format(issue))
+
+
+def _after_fork_child():
+    # Julia blocks these in every thread and waits for them in a signal
+    # listener thread, which does not exist in a forked child
+    handlers = {
+        signal.SIGINT: signal.default_int_handler,
+        signal.SIGTERM: signal.SIG_DFL,
+        signal.SIGHUP: signal.SIG_DFL,
+    }
+    for signum, handler in handlers.items():
+        signal.signal(signum, handler)
+    signal.pthread_sigmask(signal.SIG_UNBLOCK, handlers.keys())
+    JuliaEvaluator["TyJuliaSetup.after_fork_child"]()
+
+
+def _run_child(sock: socket.socket, target, args, kwargs):
+    status = 0
+    try:
+        _after_fork_child()
+        try:
+            result = (True, target(*args, **kwargs))
+        except BaseException as e:
+            result = (False, e)
+        try:
+            _send(sock, result)
+        except Exception as e:
+            # the result or the exception cannot be pickled
+            _send(sock, (False, RuntimeError("forkserver: cannot send the result: {!r}".format(e))))
+    except BaseException:
+        status = 1
+    finally:
+        sock.close()
+        sys.stdout.flush()
+        sys.stderr.flush()
+        # skip atexit hooks, they belong to the server
+        os._exit(status)
+
+
+class Worker:
+    """
+    A forked worker running `target(*args, **kwargs)`, see `fork_worker`.
+    """
+
+    def __init__(self, pid: int, sock: socket.socket):
+        self.pid = pid
+        self._sock = sock
+
+    def result(self):
+        """
+        Wait for the worker and return the value of its target, or raise the
+        exception it raised.
+        """
+        try:
+            ok, value = _recv(self._sock)
+        finally:
+            self._sock.close()
+            os.waitpid(self.pid, 0)
+        if not ok:
+            raise value
+        return value
+
+
+def fork_worker(target: typing.Callable, args=(), kwargs=None) -> Worker:
+    """
+    Fork the current, already initialized process and run `target` in the
+    child. `target` does not need to be picklable, its result does.
+    """
+    _check_forkable()
+    parent_sock, child_sock = socket.socketpair()
+    pid = os.fork()
+    if pid == 0:
+        parent_sock.close()
+        _run_child(child_sock, target, args, kwargs or {})
+    child_sock.close()
+    return Worker(pid, parent_sock)
+
+
+def preload(packages: typing.Iterable[str]):
+    """
+    Import Julia packages so that forked workers inherit them.
+    """
+    for package in packages:
+        JuliaEvaluator["import {}".format(package)]
+
+
+class ForkServer:
+    """
+    Accept requests on the Unix socket `address` and serve each of them from a
+    freshly forked worker. A request is a pickled `(target, args, kwargs)`,
+    so `target` must be importable by reference.
+    """
+
+    def __init__(self, address: str, packages: typing.Iterable[str] = ()):
+        _check_forkable()
+        self.address = address
+        preload(packages)
+        # let workers share clean pages with the server
+        JuliaEvaluator["GC.gc()"]
+        self._workers: set[int] = set()
+
+    def _reap(self):
+        for pid in list(self._workers):
+            done, _ = os.waitpid(pid, os.WNOHANG)
+            if done:
+                self._workers.discard(pid)
+
+    def serve_forever(self):
+        if os.path.exists(self.address):
+            os.unlink(self.address)
+        listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            listener.bind(self.address)
+            listener.listen()
+            listener.settimeout(1.0)
+            while True:
+                self._reap()
+                try:
+                    conn, _ = listener.accept()
+                except socket.timeout:
+                    continue
+                conn.settimeout(None)
+                try:
+                    target, args, kwargs = _recv(conn)
+                except Exception as e:
+                    _send(conn, (False, RuntimeError("forkserver: bad request: {!r}".format(e))))
+                    conn.close()
+                    continue
+                pid = os.fork()
+                if pid == 0:
+                    listener.close()
+                    _run_child(conn, target, args, kwargs)
+                conn.close()
+                self._workers.add(pid)
+        finally:
+            listener.close()
+            if os.path.exists(self.address):
+                os.unlink(self.address)
+
+
+def call(address: str, target: typing.Callable, *args, **kwargs):
+    """
+    Run `target(*args, **kwargs)` in a worker forked by the server at `address`.
+    """
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(address)
+        _send(sock, (target, args, kwargs))
+        ok, value = _recv(sock)
+    if not ok:
+        raise value
+    return value
+
+
+def main(argv=None):
+    import argparse
+
+    parser = argparse.ArgumentParser(prog="python -m tyjuliacall.forkserver")
+    parser.add_argument("address", help="path of the Unix socket to listen on")
+    parser.add_argument("--preload", nargs="*", default=[], help="Julia packages to import before forking")
+    opts = parser.parse_args(argv)
+    ForkServer(opts.address, packages=opts.preload).serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -1,13 +1,18 @@
 from __future__ import annotations
 from . import compat
 import time
+import atexit
 import contextlib
 import ctypes
+import hashlib
+import json
 import shutil
 import subprocess
 import io
+import importlib.machinery
 import os
 import sys
+import threading
 import pathlib
 import typing
 import jnumpy
@@ -18,6 +23,7 @@ from types import ModuleType
 
 PYTHONPATH = pathlib.Path(sys.executable).resolve().as_posix()
 _PYJULIA_CORE = None
+JULIA_VERSION: str | None = None
 
 del compat
 
@@ -78,6 +84,9 @@ class ENV:
     TYPY_JL_SYSIMAGE: str
     TYPY_JL_OPTS: str
     TYPY_VERBOSE: str
+    TYPY_CACHE_DIR: str
+    TYPY_RECORD_PRECOMPILES: str
+    TYPY_PERF: str
     PATH: str
     HOME: str
 
@@ -89,6 +98,14 @@ class ENV:
     PYTHON_JULIAPKG_OFFLINE: str
     PYTHON_JULIACALL_SYSIMAGE: str
 
+    JULIA_PROJECT: str
+    JULIA_LOAD_PATH: str
+    JULIA_DEPOT_PATH: str
+    JULIAUP_CHANNEL: str
+
+    ENABLE_JITPROFILING: str
+    JITDUMPDIR: str
+
     def __init__(self, env=None):
         self._env = env
 
@@ -121,11 +138,6 @@ def _load_pyjulia_core() -> ModuleType:
     elif pyjulia_core_provider == "jnumpy":
         import _tyjuliacall_jnumpy  # type: ignore
 
-        # temporary workaround, will be removed after TyJuliaCAPI update
-        from _tyjuliacall_jnumpy import Base, Main # type: ignore
-        def jl_eval(command: str):
-            return Base.eval(Main, Base.Meta.parseall(command))
-        _tyjuliacall_jnumpy.evaluate = jl_eval # type: ignore
         return _tyjuliacall_jnumpy
     else:
         raise EnvironmentError(
@@ -133,14 +145,86 @@ def _load_pyjulia_core() -> ModuleType:
         )
 
 
+class StartupPhase(typing.NamedTuple):
+    name: str
+    parent: typing.Optional[str]
+    seconds: float
+    # None for the phases that end before libjulia is loaded
+    julia_allocated_bytes: typing.Optional[int]
+    python_allocated_blocks: int
+
+
+_STARTUP_PHASES: list[StartupPhase] = []
+_STARTUP_PHASE_STACK: list[str] = []
+_JL_LIB: typing.Any = None
+
+
+def _julia_allocated_bytes():
+    if _JL_LIB is None:
+        return None
+    return _JL_LIB.jl_gc_total_bytes()
+
+
+_JL_WORLD_COUNTER: typing.Any = None
+
+
+def _julia_world():
+    # Julia's world age: defining a method, and since Julia 1.12 redefining a
+    # binding, moves it forward; None if libjulia does not export it
+    if _JL_WORLD_COUNTER is None:
+        return None
+    return _JL_WORLD_COUNTER()
+
+
+_JL_BINDING_KIND: typing.Any = None
+# results that can be handed out again, unlike numpy arrays
+_SHAREABLE_RESULTS = (int, float, complex, str, bool, type(None))
+
+
+def _binding_kind(jl_mod, name: str) -> int:
+    # 1 for a constant, 0 for a global variable, -1 if not defined yet
+    global _JL_BINDING_KIND
+    if _JL_BINDING_KIND is None:
+        _JL_BINDING_KIND = _load_pyjulia_core().evaluate(
+            "(m, s) -> (s = Symbol(s); isdefined(m, s) ? Int(isconst(m, s)) : -1)")
+    return _JL_BINDING_KIND(jl_mod, name)
+
+
 @contextlib.contextmanager
-def tictoc(msg):
-    t0 = time.time()
+def startup_phase(name: str):
+    parent = _STARTUP_PHASE_STACK[-1] if _STARTUP_PHASE_STACK else None
+    index = len(_STARTUP_PHASES)
+    # keep the phases in start order, children after their parent
+    _STARTUP_PHASES.append(StartupPhase(name, parent, 0.0, None, 0))
+    _STARTUP_PHASE_STACK.append(name)
+    b0 = _julia_allocated_bytes()
+    n0 = sys.getallocatedblocks()
+    t0 = time.perf_counter()
     try:
         yield
     finally:
+        seconds = time.perf_counter() - t0
+        b1 = _julia_allocated_bytes()
+        julia_allocated_bytes = None if b1 is None else b1 - (b0 or 0)
+        _STARTUP_PHASES[index] = StartupPhase(name, parent, seconds, julia_allocated_bytes, sys.getallocatedblocks() - n0)
+        _STARTUP_PHASE_STACK.pop()
         if Environment.TYPY_VERBOSE:
-            print(msg.format(time.time() - t0))
+            print("{} in {:.3f} seconds".format(name, seconds))
+
+
+def startup_profile() -> list[StartupPhase]:
+    """
+    Wall time and allocations of each phase of `setup()`, including the
+    phases timed inside Julia (`TyJuliaSetup.STARTUP_PHASES`).
+    """
+    phases = list(_STARTUP_PHASES)
+    if _get_pyjulia_core_provider() == "jnumpy" and any(p.name == "TyJuliaSetup.init" for p in phases):
+        for name, parent, seconds, julia_allocated_bytes in JuliaEvaluator["TyJuliaSetup.STARTUP_PHASES"]:
+            # after the last phase that shares the parent, or else after the parent
+            # itself; at the end if the parent was not recorded
+            at = max((i for i, p in enumerate(phases) if p.name == parent or p.parent == parent), default=len(phases) - 1) + 1
+            phases.insert(at, StartupPhase(name, parent, seconds, julia_allocated_bytes, 0))
+    return phases
 
 
 class JuliaModule(ModuleType):
@@ -160,16 +244,47 @@ class JuliaModule(ModuleType):
         self.__name__ = name
         self.__package__ = name
         self.__spec__ = None
+        # constant bindings looked up, names known to be global variables and
+        # `names` of the module, valid as long as the Julia world age is unchanged
+        self.__world = None
+        self.__cache = {}
+        self.__variables = set()
+        self.__names = None
+
+    def __cache_for_world(self):
+        world = _julia_world()
+        if world is None:
+            return None
+        if world != self.__world:
+            self.__world = world
+            self.__cache = {}
+            self.__variables = set()
+            self.__names = None
+        return self.__cache
 
     def __getattr__(self, name):
+        cache = self.__cache_for_world()
+        if cache is not None and name in cache:
+            return cache[name]
         try:
             att = getattr(self.__it, name)
         except:
             raise AttributeError(f"{self.__it} has no attribute {name}.") from None
+        # a global variable may be reassigned at any time, a constant cannot
+        if cache is not None and name not in self.__variables and isinstance(att, (self._jlapi.JV, *_SHAREABLE_RESULTS)):
+            kind = _binding_kind(self.__it, name)
+            # the first call compiles `_binding_kind`, which moves the world age
+            cache = self.__cache_for_world()
+            if kind == 1:
+                cache[name] = att
+            elif kind == 0:
+                self.__variables.add(name)
         return att
 
     def __dir__(self):
-        return list(self._jlapi.Main.names(self.__it, all=True, imported=True))
+        if self.__cache_for_world() is None or self.__names is None:
+            self.__names = list(self._jlapi.Main.names(self.__it, all=True, imported=True))
+        return list(self.__names)
 
     __path__ = []
 
@@ -184,6 +299,10 @@ class JuliaModule(ModuleType):
 class JuliaFinder:
     def find_module(self, fullname: str, path=None):
         if fullname.startswith("tyjuliacall."):
+            # real Python submodules such as `tyjuliacall.forkserver`;
+            # Julia modules have an empty `__path__`
+            if path and importlib.machinery.PathFinder.find_spec(fullname, path) is not None:
+                return
             return JuliaLoader
         return
 
@@ -217,9 +336,477 @@ def use_sysimage(path: str | pathlib.Path):
     Environment.TYPY_JL_SYSIMAGE = path.absolute().as_posix()
 
 
+def enable_perf_map(jitdump_dir: str | pathlib.Path | None = None):
+    """
+    Let Linux `perf` symbolize Julia JIT code: Julia writes a jitdump file
+    (`jit-<pid>.dump` in `jitdump_dir`, default `~/.debug/jit`) for every
+    method it compiles, and on Python 3.12+ the Python frames are labelled
+    through a perf map. Record with `perf record -k 1` and merge the dump with
+    `perf inject --jit`.
+
+    This function only works before importing `tyjuliacall`, as does setting
+    TYPY_PERF=1.
+    """
+    if _JL_LIB is not None:
+        raise RuntimeError("enable_perf_map() must be called before importing tyjuliacall; or set TYPY_PERF=1")
+    Environment.TYPY_PERF = "1"
+    if jitdump_dir is not None:
+        Environment.JITDUMPDIR = pathlib.Path(jitdump_dir).absolute().as_posix()
+
+
+def _enable_perf_support():
+    # read by Julia when it creates its JIT, needs Julia built with USE_PERF_JITEVENTS
+    # (the default of the official Linux binaries)
+    Environment.ENABLE_JITPROFILING = "1"
+    if hasattr(sys, "activate_stack_trampoline"):
+        sys.activate_stack_trampoline("perf")
+
+
 def use_system_typython(yes: bool = True):
     pass
 
+
+def _write_precompiles(trace: str | pathlib.Path):
+    path = pathlib.Path(trace).absolute().as_posix()
+    return JuliaEvaluator["TyJuliaSetup.write_precompiles"](path)
+
+
+@contextlib.contextmanager
+def record_precompiles(trace: str | pathlib.Path):
+    """
+    Record the concrete signatures of the Julia calls, attribute accesses and
+    operators reached from Python inside the block, then merge them as
+    `precompile(...)` statements into the file `trace`, see `build_sysimage`.
+
+    Set `TYPY_RECORD_PRECOMPILES=<trace>` to record a whole process instead.
+    """
+    from tyjuliasetup import jv
+
+    was_recording = jv.__jl_set_recording__(True)
+    try:
+        yield
+    finally:
+        jv.__jl_set_recording__(was_recording)
+        _write_precompiles(trace)
+
+
+def stats() -> dict[str, dict]:
+    """
+    Counters of the libjuliacall entry points called since the last
+    `reset_stats()`, keyed by entry point ("call", "getattr", "add", ...):
+
+        {"count": int, "errors": int,
+         "unbox": {"total_ns": int, "histogram": [int] * 32},
+         "call": {...}, "box": {...}}
+
+    `unbox` covers the argument checks and the Python to Julia conversion,
+    `call` the Julia side and `box` the conversion of the result. Bucket `i`
+    of a histogram counts latencies in [2**i, 2**(i+1)) nanoseconds.
+
+    While `start_gc_accounting()` is on, "julia" sums what the Julia side
+    allocated and paused for GC: {"bytes", "allocs", "gc_ns", "gc_pauses"}.
+    """
+    from tyjuliasetup import jv
+
+    return jv.__jl_stats__()
+
+
+def reset_stats():
+    from tyjuliasetup import jv
+
+    jv.__jl_reset_stats__()
+
+
+class JuliaAllocations(typing.NamedTuple):
+    bytes: int
+    allocs: int
+    gc_ns: int
+    gc_pauses: int
+
+
+def start_gc_accounting(annotate: bool = False):
+    """
+    Snapshot Julia's GC counters (`Base.gc_num()`) around the Julia side of
+    every crossing and add the allocated bytes, allocation count and GC time
+    to `stats()`. With `annotate`, Julia objects returned by calls also
+    carry the numbers of their call, see `julia_allocations`.
+    """
+    from tyjuliasetup import jv
+
+    jv.__jl_set_gc_accounting__(JuliaEvaluator["TyJuliaSetup.gc_snapshot_pointer"](), annotate)
+
+
+def stop_gc_accounting():
+    from tyjuliasetup import jv
+
+    jv.__jl_set_gc_accounting__(0, False)
+
+
+def julia_allocations(obj) -> typing.Optional[JuliaAllocations]:
+    """
+    The Julia allocations of the call that returned `obj`, if it is a Julia
+    object returned while `start_gc_accounting(annotate=True)` was on.
+    """
+    from tyjuliasetup import jv
+
+    try:
+        return JuliaAllocations(*jv.JV.__jlalloc__.__get__(obj))
+    except (AttributeError, TypeError):
+        return None
+
+
+class CallSite(typing.NamedTuple):
+    filename: typing.Optional[str]
+    lineno: typing.Optional[int]
+    entry: str
+    # repr of the called Julia object, or the attribute name for getattr/setattr
+    julia: typing.Optional[str]
+    samples: int
+    wall_ns: int
+    # Julia bytes allocated while converting arguments and results
+    conversion_bytes: int
+    julia_bytes: int
+
+
+def _package_dirs() -> tuple[str, ...]:
+    # frames from these directories are tyjuliacall itself, not call sites
+    dirs = (
+        pathlib.Path(__file__).parent.as_posix(),
+        str(pathlib.Path(__file__).parent),
+        pathlib.Path(__file__).parent.parent.joinpath("tyjuliacall").as_posix(),
+        str(pathlib.Path(__file__).parent.parent.joinpath("tyjuliacall")),
+    )
+    return tuple(dict.fromkeys(dirs))
+
+
+_SAMPLED_SITES: dict[tuple, list[int]] = {}
+_SAMPLE_EVERY = 0
+
+
+def _record_sample(entry, julia, filename, lineno, wall_ns, conversion_bytes, julia_bytes):
+    if julia is not None and len(julia) > 80:
+        julia = julia[:77] + "..."
+    key = (filename, lineno, entry, julia)
+    site = _SAMPLED_SITES.get(key)
+    if site is None:
+        site = _SAMPLED_SITES[key] = [0, 0, 0, 0]
+    site[0] += 1
+    site[1] += wall_ns
+    site[2] += conversion_bytes
+    site[3] += julia_bytes
+
+
+def start_sampling(every: int = 1):
+    """
+    Attribute every `every`-th Python-Julia crossing to its Python call site
+    (file and line, outside of tyjuliacall itself) and the Julia function,
+    see `sampling_report`.
+    """
+    global _SAMPLE_EVERY
+    from tyjuliasetup import jv
+
+    if every < 1:
+        raise ValueError("every must be positive")
+    _SAMPLE_EVERY = every
+    jv.__jl_set_sampling__(every, _record_sample, _package_dirs())
+
+
+def stop_sampling():
+    from tyjuliasetup import jv
+
+    jv.__jl_set_sampling__(0, None, ())
+
+
+def reset_sampling():
+    _SAMPLED_SITES.clear()
+
+
+def sampling_report(top: int = 20, sort_by: str = "wall_ns") -> list[CallSite]:
+    """
+    The `top` call sites by `sort_by` (a CallSite field). The numbers are
+    sums over the samples; multiply them by the `every` of `start_sampling`
+    to estimate totals.
+    """
+    sites = [CallSite(*key, *values) for key, values in _SAMPLED_SITES.items()]
+    sites.sort(key=lambda site: getattr(site, sort_by), reverse=True)
+    return sites[:top]
+
+
+def print_sampling_report(top: int = 20, sort_by: str = "wall_ns", file=None):
+    print("{:>8} {:>12} {:>12} {:>12}  {}".format("samples", "wall ms", "conv KiB", "julia KiB", "call site"), file=file)
+    for site in sampling_report(top, sort_by):
+        print(
+            "{:>8} {:>12.3f} {:>12.1f} {:>12.1f}  {}:{} {} {}".format(
+                site.samples, site.wall_ns / 1e6, site.conversion_bytes / 1024, site.julia_bytes / 1024,
+                site.filename, site.lineno, site.entry, site.julia or "",
+            ),
+            file=file,
+        )
+    if _SAMPLE_EVERY > 1:
+        print("(1 in {} crossings sampled)".format(_SAMPLE_EVERY), file=file)
+
+
+# tids of the Julia GC and compilation tracks in the exported trace
+_TRACE_GC_TID = 0x7FFF0001
+_TRACE_COMPILE_TID = 0x7FFF0002
+_TRACE_EVENTS: list[tuple] = []
+_TRACE_SPANS: list[tuple] = []
+
+
+def start_trace(capacity: int = 1 << 16):
+    """
+    Record a span for every Python-Julia crossing, split into its unbox,
+    call and box phases, together with the Julia GC and compilation time
+    observed during the call. The last `capacity` crossings are kept;
+    `stop_trace` writes them as a Chrome trace.
+    """
+    from tyjuliasetup import jv
+
+    gc_clock, compile_clock = JuliaEvaluator["TyJuliaSetup.start_trace_clocks"]()
+    _TRACE_EVENTS.clear()
+    _TRACE_SPANS.clear()
+    jv.__jl_start_trace__(capacity, gc_clock, compile_clock)
+
+
+@contextlib.contextmanager
+def trace_span(name: str):
+    """
+    Add a span of Python code to the trace, e.g. to group the crossings of
+    one request.
+    """
+    start = time.perf_counter_ns()
+    try:
+        yield
+    finally:
+        _TRACE_SPANS.append((name, threading.get_ident(), start, time.perf_counter_ns()))
+
+
+def _chrome_trace_events(events, spans) -> list[dict]:
+    pid = os.getpid()
+    us = lambda ns: ns / 1000
+    out = [
+        {"name": "process_name", "ph": "M", "pid": pid, "args": {"name": "Python <-> Julia"}},
+        {"name": "thread_name", "ph": "M", "pid": pid, "tid": _TRACE_GC_TID, "args": {"name": "Julia GC"}},
+        {"name": "thread_name", "ph": "M", "pid": pid, "tid": _TRACE_COMPILE_TID, "args": {"name": "Julia compile"}},
+    ]
+    for name, tid, start, end in spans:
+        out.append({"name": name, "cat": "python", "ph": "X", "pid": pid, "tid": tid, "ts": us(start), "dur": us(end - start)})
+    for entry, depth, tid, start, call, box, end, gc_ns, compile_ns in events:
+        out.append({"name": entry, "cat": "crossing", "ph": "X", "pid": pid, "tid": tid, "ts": us(start), "dur": us(end - start)})
+        bounds = [("unbox", start), ("call", call), ("box", box)]
+        reached = [(phase, t) for phase, t in bounds if t != 0]
+        for i, (phase, t) in enumerate(reached):
+            phase_end = reached[i + 1][1] if i + 1 < len(reached) else end
+            out.append({"name": phase, "cat": "phase", "ph": "X", "pid": pid, "tid": tid, "ts": us(t), "dur": us(phase_end - t)})
+        # nested crossings are included in the outermost one, report them once;
+        # the clocks give the amount, not the position, so the spans start with the Julia call
+        if depth == 0:
+            julia_start = call or start
+            for track, ns in ((_TRACE_GC_TID, gc_ns), (_TRACE_COMPILE_TID, compile_ns)):
+                if ns:
+                    out.append({
+                        "name": "GC" if track == _TRACE_GC_TID else "compile", "cat": "julia", "ph": "X",
+                        "pid": pid, "tid": track, "ts": us(julia_start), "dur": us(ns), "args": {"entry": entry},
+                    })
+    return out
+
+
+def stop_trace(path: str | pathlib.Path | None = None) -> list[dict]:
+    """
+    Stop tracing and return the trace events; if `path` is given, also write
+    them as Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open.
+    """
+    from tyjuliasetup import jv
+
+    _TRACE_EVENTS.extend(jv.__jl_stop_trace__())
+    JuliaEvaluator["TyJuliaSetup.stop_trace_clocks"]()
+    events = _chrome_trace_events(_TRACE_EVENTS, _TRACE_SPANS)
+    _TRACE_EVENTS.clear()
+    _TRACE_SPANS.clear()
+    if path is not None:
+        with open(path, "w", encoding="utf-8") as f:
+            json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, f)
+    return events
+
+
+def live_handles() -> int:
+    """
+    The number of Julia objects currently held by Python `JV` objects.
+    """
+    from tyjuliasetup import jv
+
+    return jv.__jl_live_handles__()
+
+
+def pending_releases() -> int:
+    """
+    The number of Julia objects released by Python but not yet freed in
+    Julia: they are freed in batches at the next call into Julia.
+    """
+    from tyjuliasetup import jv
+
+    return jv.__jl_pending_releases__()
+
+
+def flush_releases():
+    from tyjuliasetup import jv
+
+    jv.__jl_flush_releases__()
+
+
+def clear_evaluate_cache():
+    """
+    Forget the code parsed by `JuliaEvaluator[...]` and the values it kept for
+    literals and anonymous functions, e.g. after redefining a macro they use.
+    """
+    JuliaEvaluator["TyJuliaSetup.clear_eval_cache"]()
+
+
+def enable_box_cache(on: bool = True):
+    """
+    Box a mutable Julia object to the JV already wrapping it, as long as that
+    JV is alive, so the same Julia object is the same Python object. Each
+    boxed value then costs one more lookup.
+    """
+    from tyjuliasetup import jv
+
+    jv.__jl_set_box_cache__(JuliaEvaluator["TyJuliaSetup.box_identity_pointer"]() if on else 0)
+
+
+def julia_backtraces(on: bool = True) -> bool:
+    """
+    Append the Julia backtrace to the message of Julia errors raised in
+    Python, and return the previous setting. Formatting a backtrace costs
+    far more than the error itself, keep it off around code that uses
+    Julia exceptions for control flow.
+    """
+    from tyjuliasetup import jv
+
+    return jv.__jl_set_backtraces__(on)
+
+
+@contextlib.contextmanager
+def _no_convert_scope():
+    from tyjuliasetup import jv
+
+    jv.__jl_no_convert__(1)
+    try:
+        yield
+    finally:
+        jv.__jl_no_convert__(-1)
+
+
+def no_convert(f=None):
+    """
+    Return Julia results as JVs instead of converting them to Python
+    (numpy arrays, tuples, numbers...), for values only passed on to the
+    next Julia call. `nothing` is still None.
+
+    `with no_convert():` applies to the calls, attributes and indexing in
+    the block on the current thread. `no_convert(f)` gives a new handle to
+    the Julia function `f` whose calls are not converted. For a single
+    call, use `f.raw(...)`.
+    """
+    if f is None:
+        return _no_convert_scope()
+    from tyjuliasetup import jv
+
+    return jv.__jl_raw_handle__(f)
+
+
+class HandleGroup(typing.NamedTuple):
+    type: str
+    # ((filename, lineno, function), ...) innermost first, None without backtraces
+    site: typing.Optional[tuple]
+    count: int
+
+
+class HandleSnapshot:
+    """
+    The Julia objects held by Python and boxed since `start_handle_tracking`,
+    see `handle_snapshot`.
+    """
+
+    def __init__(self, records: list[tuple]):
+        # serial -> (type, site)
+        self.records = {serial: (type, site) for serial, type, site in records}
+
+    def __len__(self):
+        return len(self.records)
+
+    def by_type(self) -> dict[str, int]:
+        counts: dict[str, int] = {}
+        for type, _ in self.records.values():
+            counts[type] = counts.get(type, 0) + 1
+        return dict(sorted(counts.items(), key=lambda item: item[1], reverse=True))
+
+    def diff(self, older: HandleSnapshot) -> list[HandleGroup]:
+        """
+        The objects alive in this snapshot but not in `older`, grouped by
+        type and allocation site, largest group first.
+        """
+        groups: dict[tuple, int] = {}
+        for serial, key in self.records.items():
+            if serial not in older.records:
+                groups[key] = groups.get(key, 0) + 1
+        return sorted((HandleGroup(type, site, count) for (type, site), count in groups.items()), key=lambda g: g.count, reverse=True)
+
+
+def _allocation_site(depth: int, skip: tuple[str, ...]) -> tuple:
+    frame = sys._getframe(1)
+    site = []
+    while frame is not None and len(site) < depth:
+        code = frame.f_code
+        if not code.co_filename.startswith(skip):
+            site.append((code.co_filename, frame.f_lineno, code.co_name))
+        frame = frame.f_back
+    return tuple(site)
+
+
+def start_handle_tracking(backtraces: bool = False, depth: int = 8):
+    """
+    Record the Julia type of every Julia object boxed into a `JV` from now
+    on, and with `backtraces` the `depth` innermost Python frames that
+    created it, so that `handle_snapshot()` can tell what is kept alive.
+    """
+    from tyjuliasetup import jv
+
+    skip = _package_dirs()
+    capture = (lambda: _allocation_site(depth, skip)) if backtraces else None
+    jv.__jl_set_handle_tracking__(True, capture)
+
+
+def stop_handle_tracking():
+    from tyjuliasetup import jv
+
+    jv.__jl_set_handle_tracking__(False, None)
+
+
+def handle_snapshot() -> HandleSnapshot:
+    from tyjuliasetup import jv
+
+    return HandleSnapshot(jv.__jl_handle_snapshot__())
+
+
+def build_sysimage(trace: str | pathlib.Path, packages: typing.Iterable[str], out: str | pathlib.Path):
+    """
+    Build a sysimage at `out` with PackageCompiler, containing `packages`
+    (they must be installed in the global Julia environment, as must be
+    PackageCompiler) and precompiled for the statements recorded in `trace`.
+    Use it with `use_sysimage(out)`.
+    """
+    jl_exe = shutil.which("julia")
+    if not jl_exe:
+        raise RuntimeError("Julia not found")
+    packages = list(dict.fromkeys([*packages, "TyPython", "TyJuliaCAPI"]))
+    escape = jnumpy.utils.escape_to_julia_rawstr
+    code = "import PackageCompiler; PackageCompiler.create_sysimage(String[{}]; sysimage_path={}, precompile_statements_file={})".format(
+        ", ".join(escape(package) for package in packages),
+        escape(pathlib.Path(out).absolute().as_posix()),
+        escape(pathlib.Path(trace).absolute().as_posix()),
+    )
+    subprocess.check_call([jl_exe, "--startup-file=no", "-e", code], env=os.environ)
+
 def use_backend(backend : typing.Literal['pycall', 'jnumpy']):
     Environment.PYJULIA_CORE = backend
 
@@ -234,6 +821,20 @@ class _JuliaCodeEvaluatorClass:
             self._eval_func = _load_pyjulia_core().evaluate
         return self._eval_func
 
+    def evaluate(self, code: str, module=None, filename: str | None = None, line: int = 1) -> typing.Any:
+        """
+        Evaluate `code`, which may hold several statements, in the Julia
+        `module` (a `JuliaModule` or a JV, default Main). Julia reports the
+        code as coming from `filename` (default "none") starting at `line`,
+        in errors, backtraces and `methods`.
+        """
+        eval_func = self.assure_pythoncall()
+        if isinstance(module, JuliaModule):
+            module = module._JuliaModule__it
+        if module is None and filename is None and line == 1:
+            return eval_func(code)
+        return eval_func(code, module, filename, line)
+
     def __getitem__(self, arg) -> typing.Any:
         eval_func = self.assure_pythoncall()
         o = None
@@ -278,7 +879,67 @@ end
 """
 
 
-def get_sysimage_and_projdir(jl_exe: str):
+def get_cache_dir() -> pathlib.Path:
+    if Environment.TYPY_CACHE_DIR:
+        return pathlib.Path(Environment.TYPY_CACHE_DIR)
+    if sys.platform == "win32" and os.environ.get("LOCALAPPDATA"):
+        return pathlib.Path(os.environ["LOCALAPPDATA"]) / "tyjuliacall"
+    if os.environ.get("XDG_CACHE_HOME"):
+        return pathlib.Path(os.environ["XDG_CACHE_HOME"]) / "tyjuliacall"
+    return pathlib.Path.home() / ".cache" / "tyjuliacall"
+
+
+def _discovery_cache_path(jl_exe: str) -> pathlib.Path:
+    # everything that can change what `julia` reports; a juliaup launcher keeps
+    # its mtime when the channel changes, hence JULIAUP_CHANNEL
+    jl_exe_path = pathlib.Path(jl_exe).resolve()
+    key = [
+        jl_exe_path.as_posix(),
+        jl_exe_path.stat().st_mtime_ns,
+        Environment.TYPY_JL_SYSIMAGE,
+        Environment.JULIA_PROJECT,
+        Environment.JULIA_LOAD_PATH,
+        Environment.JULIA_DEPOT_PATH,
+        Environment.JULIAUP_CHANNEL,
+    ]
+    digest = hashlib.sha1(json.dumps(key).encode("utf-8")).hexdigest()
+    return get_cache_dir() / "discovery-{}.json".format(digest)
+
+
+def _load_discovery_cache(cache_path: pathlib.Path):
+    try:
+        with open(cache_path, encoding="utf-8") as f:
+            cached = json.load(f)
+        sys_image = cached["sys_image"]
+        global_proj_dir = cached["global_proj_dir"]
+        julia_version = cached["julia_version"]
+    except (OSError, ValueError, KeyError, TypeError):
+        return None
+    # the sysimage may have been rebuilt or removed since
+    if not os.path.isfile(sys_image) or os.path.getmtime(sys_image) != cached.get("sys_image_mtime"):
+        return None
+    return sys_image, global_proj_dir, julia_version
+
+
+def _save_discovery_cache(cache_path: pathlib.Path, sys_image: str, global_proj_dir: str, julia_version: str):
+    cached = {
+        "sys_image": sys_image,
+        "sys_image_mtime": os.path.getmtime(sys_image),
+        "global_proj_dir": global_proj_dir,
+        "julia_version": julia_version,
+    }
+    # concurrent workers may race here, so write a private file and move it in place
+    try:
+        cache_path.parent.mkdir(parents=True, exist_ok=True)
+        tmp_path = cache_path.with_name("{}.{}.tmp".format(cache_path.name, os.getpid()))
+        with open(tmp_path, "w", encoding="utf-8") as f:
+            json.dump(cached, f)
+        os.replace(tmp_path, cache_path)
+    except OSError:
+        pass
+
+
+def _discover_sysimage_and_projdir(jl_exe: str):
     if Environment.TYPY_JL_SYSIMAGE:
         sys_image = Environment.TYPY_JL_SYSIMAGE
         res = invoke_julia(
@@ -287,12 +948,12 @@ def get_sysimage_and_projdir(jl_exe: str):
                 "--compile=min",
                 "-O0",
                 "-e",
-                "import Pkg; println(dirname(Pkg.project().path))",
+                "import Pkg; println(dirname(Pkg.project().path)); println(VERSION)",
             ],
         )
         if not res or not isinstance(res, bytes) or not res.strip():
             raise ValueError("Julia.exe failed")
-        global_proj_dir = res.strip().decode("utf-8")
+        global_proj_dir, julia_version = res.strip().decode("utf-8").splitlines()
     else:
         res = invoke_julia(
             jl_exe,
@@ -300,15 +961,31 @@ def get_sysimage_and_projdir(jl_exe: str):
                 "--compile=min",
                 "-O0",
                 "-e",
-                "import Pkg; println(unsafe_string(Base.JLOptions().image_file)); println(dirname(Pkg.project().path))",
+                "import Pkg; println(unsafe_string(Base.JLOptions().image_file)); println(dirname(Pkg.project().path)); println(VERSION)",
             ],
         )
         if not res or not isinstance(res, bytes) or not res.strip():
             raise ValueError("Julia.exe failed")
-        sys_image, global_proj_dir = res.strip().decode("utf-8").splitlines()
+        sys_image, global_proj_dir, julia_version = res.strip().decode("utf-8").splitlines()
 
     sys_image = pathlib.Path(sys_image.strip()).absolute().as_posix()
     global_proj_dir = pathlib.Path(global_proj_dir.strip()).absolute().as_posix()
+    return sys_image, global_proj_dir, julia_version.strip()
+
+
+def get_sysimage_and_projdir(jl_exe: str):
+    """
+    Find the sysimage and the global project of `jl_exe`. The result of the
+    julia subprocess is cached in `get_cache_dir()`, keyed by the julia binary,
+    its mtime and the environment variables that affect the result.
+    """
+    global JULIA_VERSION
+    cache_path = _discovery_cache_path(jl_exe)
+    cached = _load_discovery_cache(cache_path)
+    if cached is None:
+        cached = _discover_sysimage_and_projdir(jl_exe)
+        _save_discovery_cache(cache_path, *cached)
+    sys_image, global_proj_dir, JULIA_VERSION = cached
     return sys_image, global_proj_dir
 
 def setup():
@@ -319,7 +996,8 @@ def setup():
         raise RuntimeError("Julia not found")
 
     # sync PyCall and PythonCall
-    BASE_IMAGE, GLOBAL_PROJ_DIR = get_sysimage_and_projdir(jl_exe)
+    with startup_phase("discover sysimage and project"):
+        BASE_IMAGE, GLOBAL_PROJ_DIR = get_sysimage_and_projdir(jl_exe)
 
     Environment.PYTHON = PYTHONPATH
     Environment.PYCALL_INPROC_LIBPYPTR = hex(ctypes.pythonapi._handle)
@@ -339,6 +1017,13 @@ def setup():
         nonlocal lib
         lib = _lib
         global _eval_jl
+        global _JL_LIB
+        global _JL_WORLD_COUNTER
+        _JL_LIB = _lib
+        _JL_LIB.jl_gc_total_bytes.restype = ctypes.c_int64
+        if hasattr(_JL_LIB, "jl_get_world_counter"):
+            _JL_WORLD_COUNTER = _JL_LIB.jl_get_world_counter
+            _JL_WORLD_COUNTER.restype = ctypes.c_size_t
 
         def _eval_jl(x: str):
             source_code = code_template.format(x)
@@ -353,8 +1038,12 @@ def setup():
             return None
         return
 
+    if Environment.TYPY_PERF:
+        _enable_perf_support()
+
     user_set_pyjulia_core = Environment.PYJULIA_CORE
-    with tictoc("Julia initialized in {} seconds"):
+    # loads libjulia and maps the sysimage
+    with startup_phase("init_libjulia"):
         jnumpy.init.init_libjulia(_init, experimental_fast_init=True)
 
     # to workaround sysimage `__init__`
@@ -364,12 +1053,13 @@ def setup():
         Environment.PYJULIA_CORE = "jnumpy"
 
     pyjulia_core_provider = _get_pyjulia_core_provider()
-    with tictoc("PyJulia-Core initialized in {} seconds"):
+    with startup_phase("PyJulia-Core"):
         if pyjulia_core_provider == "jnumpy":
 
             # import TyPython and TyJuliaCAPI in julia global env
             try:
-                _exec_julia("import TyPython, TyJuliaCAPI")
+                with startup_phase("import TyPython, TyJuliaCAPI"):
+                    _exec_julia("import TyPython, TyJuliaCAPI")
             except JuliaError:
                 raise JuliaError("Failed to import Julia package TyPython and TyJuliaCAPI, try to install TyPython and TyJuliaCAPI in Julia.") from None
 
@@ -379,21 +1069,24 @@ def setup():
                 TyJuliaSetup_path = (
                     pathlib.Path(__file__).parent.absolute().joinpath("src").joinpath("TyJuliaSetup.jl").as_posix()
                 )
-                _exec_julia(
-                    f"""
-                    include({jnumpy.utils.escape_to_julia_rawstr(TyJuliaSetup_path)})
-                    TyJuliaSetup.init()
-                """)
+                with startup_phase("include TyJuliaSetup"):
+                    _exec_julia(f"include({jnumpy.utils.escape_to_julia_rawstr(TyJuliaSetup_path)})")
+                with startup_phase("TyJuliaSetup.init"):
+                    _exec_julia("TyJuliaSetup.init()")
             except JuliaError:
                 raise JuliaError("Failed to init TyJuliaSetup.") from None
 
             import _tyjuliacall_jnumpy  # type: ignore
             from tyjuliasetup import jv
 
-            with tictoc("setup_jv in {} seconds"):
+            with startup_phase("setup_api"):
                 _tyjuliacall_jnumpy.setup_api(jv.JV, jv)
                 _tyjuliacall_jnumpy.setup_basics(_tyjuliacall_jnumpy)
                 _tyjuliacall_jnumpy.JV = jv.JV
+
+            if Environment.TYPY_RECORD_PRECOMPILES:
+                jv.__jl_set_recording__(True)
+                atexit.register(_write_precompiles, pathlib.Path(Environment.TYPY_RECORD_PRECOMPILES).absolute())
         elif pyjulia_core_provider == "pycall":
             lib.jl_eval_string("import PyCall".encode("utf-8"))
             lib.jl_eval_string("Pkg.activate(io=devnull)".encode("utf-8"))
@@ -1,4 +1,5 @@
 from __future__ import annotations
+import collections.abc
 import typing
 
 __jl_invoke__: typing.Callable[[JV, tuple, dict], typing.Any]
@@ -6,7 +7,7 @@ __jl_getattr__: typing.Callable[[JV, str], typing.Any]
 __jl_setattr__: typing.Callable[[JV, str, typing.Any], typing.Any]
 __jl_hasattr__: typing.Callable[[JV, str], typing.Any]
 __jl_getitem__: typing.Callable[[JV, typing.Any], typing.Any]
-__jl_setitem__: typing.Callable[[JV, typing.Any, typing.Any], typing.Any]
+__jl_setitem__: typing.Callable[[JV, typing.Any, typing.Any], None]
 __jl_add__: typing.Callable[[JV, typing.Any], typing.Any]
 __jl_sub__: typing.Callable[[JV, typing.Any], typing.Any]
 __jl_mul__: typing.Callable[[JV, typing.Any], typing.Any]
@@ -33,16 +34,52 @@ __jl_pos__: typing.Callable[[JV], typing.Any]
 __jl_neg__: typing.Callable[[JV], typing.Any]
 __jl_abs__: typing.Callable[[JV], typing.Any]
 __jl_hash__: typing.Callable[[JV], typing.Any]
+__jl_len__: typing.Callable[[JV], int]
+__jl_mapping_getitem__: typing.Callable[[JV, typing.Any], typing.Any]
+__jl_mapping_contains__: typing.Callable[[JV, typing.Any], bool]
+__jl_iter__: typing.Callable[[JV, int], typing.Iterator[typing.Any]]
+__jl_set_recording__: typing.Callable[[bool], bool]
+__jl_stats__: typing.Callable[[], dict]
+__jl_reset_stats__: typing.Callable[[], None]
+__jl_set_sampling__: typing.Callable[[int, typing.Optional[typing.Callable], tuple], None]
+__jl_live_handles__: typing.Callable[[], int]
+__jl_pending_releases__: typing.Callable[[], int]
+__jl_flush_releases__: typing.Callable[[], None]
+__jl_set_handle_tracking__: typing.Callable[[bool, typing.Optional[typing.Callable[[], typing.Any]]], None]
+__jl_handle_snapshot__: typing.Callable[[], list]
+__jl_set_box_cache__: typing.Callable[[int], None]
+__jl_set_backtraces__: typing.Callable[[bool], bool]
+__jl_invoke_raw__: typing.Callable[[JV, tuple, dict], typing.Any]
+__jl_no_convert__: typing.Callable[[int], int]
+__jl_raw_handle__: typing.Callable[[JV], JV]
+__jl_set_gc_accounting__: typing.Callable[[int, bool], None]
+__jl_start_trace__: typing.Callable[[int, int, int], None]
+__jl_stop_trace__: typing.Callable[[], list]
 __jl_repr__: typing.Callable[[JV], str]
 _jl_repr_pretty_: typing.Callable[[JV], str]
 
+# keep in sync with `IterKind` in libjuliacall/include/JVIterator.hpp
+_ITER_ELEMENTS = 0
+_ITER_KEYS = 1
+_ITER_VALUES = 2
+_ITER_ITEMS = 3
+_ITER_REVERSED = 4
+
 
 class JV:
-    __slots__ = ["__jlslot__"]
+    # __jlalloc__: Julia allocations of the call that returned it, see `start_gc_accounting`
+    __slots__ = ["__jlslot__", "__jlalloc__"]
 
     def __call__(self, *args, **kwargs):
         return __jl_invoke__(self, args, kwargs)
 
+    def raw(self, *args, **kwargs):
+        """
+        Call without converting the result: it stays a JV (`nothing` is None),
+        to be passed to the next Julia call as is.
+        """
+        return __jl_invoke_raw__(self, args, kwargs)
+
     def __getattr__(self, name: str):
         return __jl_getattr__(self, name)
 
@@ -140,16 +177,90 @@ class JV:
         p.text(_jl_repr_pretty_(self) if not cycle else "...")
 
     def __iter__(self):
-        global _jl_iterate
+        return __jl_iter__(self, _ITER_ELEMENTS)
+
+
+class _JVValuesView(collections.abc.ValuesView):
+    __slots__ = ()
+
+    def __iter__(self):
+        return __jl_iter__(self._mapping, _ITER_VALUES)
+
+
+class _JVItemsView(collections.abc.ItemsView):
+    __slots__ = ()
+
+    def __iter__(self):
+        return __jl_iter__(self._mapping, _ITER_ITEMS)
+
+
+class JVMapping(JV):
+    """
+    Julia `AbstractDict` or `NamedTuple`. The keys of a `NamedTuple` are
+    given as `str`. `get`, `keys`, `values` and `items` shadow Julia fields
+    or properties of the same name; read such a `NamedTuple` field by key,
+    e.g. `nt["values"]`.
+    """
+
+    __slots__ = ()
+
+    def __len__(self):
+        return __jl_len__(self)
+
+    def __getitem__(self, key: typing.Any):
+        return __jl_mapping_getitem__(self, key)
+
+    def __contains__(self, key: typing.Any):
+        return __jl_mapping_contains__(self, key)
+
+    def __iter__(self):
+        return __jl_iter__(self, _ITER_KEYS)
+
+    def get(self, key: typing.Any, default: typing.Any = None):
         try:
-            jl_iterate = _jl_iterate  # type: ignore
-        except NameError:
-            from _tyjuliacall_jnumpy import Base  # type: ignore
+            return __jl_mapping_getitem__(self, key)
+        except KeyError:
+            return default
+
+    def keys(self):
+        return collections.abc.KeysView(self)
+
+    def values(self):
+        return _JVValuesView(self)
+
+    def items(self):
+        return _JVItemsView(self)
+
+
+class JVSequence(JV):
+    """
+    Julia `Vector{Any}`, a 1-based proxy: like any other JV, indices are
+    Julia's 1-based indices, `xs[0]` and negative indices are Julia errors
+    and slices are not supported, so `index` returns a 1-based position.
+    For that reason it is not registered as a `collections.abc.Sequence`.
+    """
+
+    __slots__ = ()
+
+    def __len__(self):
+        return __jl_len__(self)
+
+    def __iter__(self):
+        return __jl_iter__(self, _ITER_ELEMENTS)
+
+    def __reversed__(self):
+        return __jl_iter__(self, _ITER_REVERSED)
+
+    def index(self, value: typing.Any, start: int = 1, stop: typing.Optional[int] = None):
+        for i, v in enumerate(self, 1):
+            if stop is not None and i >= stop:
+                break
+            if i >= start and (v is value or v == value):
+                return i
+        raise ValueError(f"{value!r} is not in the Julia vector")
+
+    def count(self, value: typing.Any):
+        return sum(1 for v in self if v is value or v == value)
 
-            jl_iterate = _jl_iterate = Base.iterate
 
-        pair = jl_iterate(self)
-        while pair is not None:
-            element, state = pair
-            yield element
-            pair = jl_iterate(self, state)
+collections.abc.Mapping.register(JVMapping)
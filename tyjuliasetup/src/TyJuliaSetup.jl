@@ -486,11 +486,16 @@ using TyPython: C
 #     nothing
 # end
 
+include("containers.jl")
+include("recording.jl")
+include("tracing.jl")
+include("evaluate.jl")
 include("boot.jl")
+include("fork.jl")
 
 # this is called after CPython.init()
 function init()
-    TyPython.CPython.init()
+    timed_phase(TyPython.CPython.init, "TyPython.CPython.init", "TyJuliaSetup.init")
     boot()
     # builtins = CPython.get_py_builtin()
     # numpy = CPython.get_numpy()
@@ -1,4 +1,5 @@
 using Libdl
+using Dates
 using TyJuliaCAPI
 import TyPython.CPython
 import TyPython.CPython: Py, py_cast, UnsafeNew, PyObject, BorrowReference
@@ -8,6 +9,26 @@ const _get_capi = Ref{Ptr{Cvoid}}(C_NULL)
 const _pycast2jl = Ref{Ptr{Cvoid}}(C_NULL)
 const _pycast2py = Ref{Ptr{Cvoid}}(C_NULL)
 const _jl_repr_pretty = Ref{Ptr{Cvoid}}(C_NULL)
+const _iterate_chunk = Ref{Ptr{Cvoid}}(C_NULL)
+const _unpack_tuple = Ref{Ptr{Cvoid}}(C_NULL)
+const _box_numpy_scalar = Ref{Ptr{Cvoid}}(C_NULL)
+const _jlapi_bootstrap = Ref{Ptr{Cvoid}}(C_NULL)
+const _free_handles = Ref{Ptr{Cvoid}}(C_NULL)
+const _hash = Ref{Ptr{Cvoid}}(C_NULL)
+
+# (name, parent, seconds, allocated bytes) of the startup phases run inside Julia,
+# merged into `tyjuliasetup.startup_profile()`
+const STARTUP_PHASES = Tuple{String, String, Float64, Int64}[]
+
+function timed_phase(f, name::String, parent::String)
+    t0 = time_ns()
+    b0 = ccall(:jl_gc_total_bytes, Int64, ())
+    try
+        return f()
+    finally
+        push!(STARTUP_PHASES, (name, parent, (time_ns() - t0) / 1e9, ccall(:jl_gc_total_bytes, Int64, ()) - b0))
+    end
+end
 
 function pycast2jl(out::Ptr{TyJuliaCAPI.JV}, T::Int64, p::Ptr{Cvoid})
     py = Py(BorrowReference(), reinterpret(CPython.C.Ptr{CPython.PyObject}, p))
@@ -23,6 +44,15 @@ end
 
 get_pycast2jl() = @cfunction(pycast2jl, TyJuliaCAPI.ErrorCode, (Ptr{TyJuliaCAPI.JV}, Int64, Ptr{Cvoid}, ))
 
+# zero-copy `Vector{UInt8}` over a writable Python buffer, `owner` is the
+# exporting object (a memoryview) which the array keeps alive
+function wrap_pybuffer(owner::UInt64, ptr::UInt64, len::Int64)
+    py = Py(BorrowReference(), reinterpret(CPython.C.Ptr{CPython.PyObject}, Ptr{Cvoid}(owner)))
+    arr = unsafe_wrap(Array, Ptr{UInt8}(ptr), len; own=false)
+    finalizer(_ -> (py; nothing), arr)
+    return arr
+end
+
 function pycast2py(v::TyJuliaCAPI.JV)
     v′ = TyJuliaCAPI.JV_LOAD(v)
     try
@@ -66,31 +96,253 @@ end
 
 get_jl_repr_pretty() = @cfunction(jl_display, Ptr{TyPython.CPython.PyObject}, (TyJuliaCAPI.JV,))
 
+function _iterate_chunk!(out::Ptr{TyJuliaCAPI.JV}, n::Int64, it::Union{Iterators.Stateful, Stepwise}, count::Ptr{Int64})
+    i = 0
+    while i < n
+        x = iterate(it)
+        x === nothing && break
+        i += 1
+        unsafe_store!(out, TyJuliaCAPI.JV_ALLOC(x[1]), i)
+        unsafe_store!(count, i)
+    end
+    return nothing
+end
+
+# on failure the exception is handed to libjuliacall in `err`, which throws
+# it again through the C API after the elements fetched before it
+function iterate_chunk(out::Ptr{TyJuliaCAPI.JV}, n::Int64, self::TyJuliaCAPI.JV, count::Ptr{Int64}, err::Ptr{TyJuliaCAPI.JV})
+    unsafe_store!(count, 0)
+    try
+        # function barrier: specialize the loop on the concrete iterator type
+        _iterate_chunk!(out, n, TyJuliaCAPI.JV_LOAD(self), count)
+    catch e
+        unsafe_store!(err, TyJuliaCAPI.JV_ALLOC(e))
+        return TyJuliaCAPI.ERROR
+    end
+    return TyJuliaCAPI.OK
+end
+
+get_iterate_chunk() = @cfunction(iterate_chunk, TyJuliaCAPI.ErrorCode, (Ptr{TyJuliaCAPI.JV}, Int64, TyJuliaCAPI.JV, Ptr{Int64}, Ptr{TyJuliaCAPI.JV}))
+
+function _new_pyref(x)
+    py = py_cast(TyPython.CPython.Py, x)
+    TyPython.CPython.PyAPI.Py_IncRef(py)
+    return reinterpret(Ptr{TyPython.CPython.PyObject}, TyPython.CPython.unsafe_unwrap(py))
+end
+
+# homogeneous isbits tuples, e.g. `(residual, tol)`, need no handles at all
+function _unpack_tuple!(pys::Ptr{Ptr{TyPython.CPython.PyObject}}, ::Ptr{TyJuliaCAPI.JV}, x::NTuple{N, T}) where {N, T<:NumPyElementTypes}
+    for i in 1:N
+        unsafe_store!(pys, _new_pyref(x[i]), i)
+    end
+end
+
+function _unpack_tuple!(pys::Ptr{Ptr{TyPython.CPython.PyObject}}, jvs::Ptr{TyJuliaCAPI.JV}, x::Tuple)
+    for i in 1:length(x)
+        el = x[i]
+        if el isa NumPyElementTypes
+            unsafe_store!(pys, _new_pyref(el), i)
+        else
+            unsafe_store!(jvs, TyJuliaCAPI.JV_ALLOC(el), i)
+        end
+    end
+end
+
+function unpack_tuple(pys::Ptr{Ptr{TyPython.CPython.PyObject}}, jvs::Ptr{TyJuliaCAPI.JV}, cap::Int64, self::TyJuliaCAPI.JV, n::Ptr{Int64})
+    try
+        x = TyJuliaCAPI.JV_LOAD(self)::Tuple
+        unsafe_store!(n, length(x))
+        # the caller retries with a buffer of `length(x)`
+        length(x) > cap && return TyJuliaCAPI.OK
+        _unpack_tuple!(pys, jvs, x)
+    catch
+        return TyJuliaCAPI.ERROR
+    end
+    return TyJuliaCAPI.OK
+end
+
+get_unpack_tuple() = @cfunction(unpack_tuple, TyJuliaCAPI.ErrorCode, (Ptr{Ptr{TyPython.CPython.PyObject}}, Ptr{TyJuliaCAPI.JV}, Int64, TyJuliaCAPI.JV, Ptr{Int64}))
+
+# indexed by `NumPyScalarCode` in libjuliacall/include/common.hpp
+const NumPyScalarTypes = (Bool, Int8, Int16, Int32, Int64, UInt8, UInt16, UInt32, UInt64, Float16, Float32, Float64, ComplexF32, ComplexF64)
+const NumPyScalarCode_datetime64 = 14
+const NumPyScalarCode_timedelta64 = 15
+
+# NPY_DATETIMEUNIT, the business-day unit (3) and generic units are not supported
+function _numpy_period(base::Int32, value::Int64)
+    base == 0 && return Year(value)
+    base == 1 && return Month(value)
+    base == 2 && return Week(value)
+    base == 4 && return Day(value)
+    base == 5 && return Hour(value)
+    base == 6 && return Minute(value)
+    base == 7 && return Second(value)
+    base == 8 && return Millisecond(value)
+    base == 9 && return Microsecond(value)
+    base == 10 && return Nanosecond(value)
+    error("unsupported numpy datetime unit: $base")
+end
+
+# `data` points to `obval` of a numpy scalar; datetime64/timedelta64 store
+# an Int64 followed by their unit metadata `{Int32 base; Int32 num}`
+function _box_numpy_datetime(code::Int64, data::Ptr{Cvoid})
+    value = unsafe_load(Ptr{Int64}(data))
+    value == typemin(Int64) && return missing # NaT
+    base = unsafe_load(Ptr{Int32}(data + 8))
+    num = unsafe_load(Ptr{Int32}(data + 12))
+    period = _numpy_period(base, value * num)
+    code == NumPyScalarCode_timedelta64 && return period
+    epoch = DateTime(1970)
+    period isa Union{Year, Month} && return epoch + period
+    # DateTime has millisecond precision, finer values throw an InexactError
+    return epoch + convert(Millisecond, period)
+end
+
+function box_numpy_scalar(out::Ptr{TyJuliaCAPI.JV}, code::Int64, data::Ptr{Cvoid})
+    try
+        if code == NumPyScalarCode_datetime64 || code == NumPyScalarCode_timedelta64
+            x = _box_numpy_datetime(code, data)
+        else
+            x = unsafe_load(Ptr{NumPyScalarTypes[code + 1]}(data))
+        end
+        unsafe_store!(out, TyJuliaCAPI.JV_ALLOC(x))
+    catch
+        return TyJuliaCAPI.ERROR
+    end
+    return TyJuliaCAPI.OK
+end
+
+get_box_numpy_scalar() = @cfunction(box_numpy_scalar, TyJuliaCAPI.ErrorCode, (Ptr{TyJuliaCAPI.JV}, Int64, Ptr{Cvoid}))
+
+square(x) = x .^ 2
+
+# keep the order in sync with `JLAPI_TYPE_SLOTS` in libjuliacall/include/common.hpp
+const JLAPI_TYPES = (
+    Nothing, Integer, AbstractFloat, AbstractString, Bool, Complex, AbstractSet, AbstractDict,
+    AbstractArray, BitArray, String, Number, Tuple, NamedTuple, Vector{Any}, KeyNotFound, IsbitsChunks,
+    Stepwise,
+)
+
+# keep the order in sync with `JLAPI_HANDLES` in libjuliacall/include/common.hpp
+const JLAPI_HANDLES = (
+    Base.eltype, Base.repr, Base.display, Base.isa, Base.ncodeunits, square, (<:),
+    Base.:+, Base.:-, Base.Broadcast.BroadcastFunction(*), Base.:*, Base.:/, Base.div, Base.mod, Base.:^,
+    Base.:<<, Base.:>>, Base.:|, Base.:⊻, Base.:&,
+    Base.:(==), Base.:(!=), Base.:(<=), Base.:(>=), Base.:<, Base.:>,
+    Base.abs, Base.:~, Base.in, Base.hash, Base.isempty, Base.getindex, Base.setindex!, Base.tuple,
+    Base.length, Base.convert, Base.reshape,
+    chunked_iterator, next_isbits_chunk, wrap_pybuffer, mapping_getitem, mapping_haskey,
+    record_call, record_getattr, Base.identity, evaluate_cached, Base.throw,
+    true, false, nothing, 0, Base, Main, Int64, String,
+)
+
+function jlapi_bootstrap(types::Ptr{TyJuliaCAPI.JV}, ntypes::Int64, handles::Ptr{TyJuliaCAPI.JV}, nhandles::Int64)
+    ntypes == length(JLAPI_TYPES) && nhandles == length(JLAPI_HANDLES) || return TyJuliaCAPI.ERROR
+    try
+        timed_phase("init_JLAPI", "setup_api") do
+            for i in 1:ntypes
+                unsafe_store!(types, TyJuliaCAPI.JV_ALLOC(JLAPI_TYPES[i]), i)
+            end
+            for i in 1:nhandles
+                unsafe_store!(handles, TyJuliaCAPI.JV_ALLOC(JLAPI_HANDLES[i]), i)
+            end
+        end
+    catch
+        return TyJuliaCAPI.ERROR
+    end
+    return TyJuliaCAPI.OK
+end
+
+get_jlapi_bootstrap() = @cfunction(jlapi_bootstrap, TyJuliaCAPI.ErrorCode, (Ptr{TyJuliaCAPI.JV}, Int64, Ptr{TyJuliaCAPI.JV}, Int64))
+
+
+# frees the handles released by Python finalizers in one crossing,
+# see libjuliacall/include/ReleaseQueue.hpp
+function free_handles(free::Ptr{Cvoid}, handles::Ptr{TyJuliaCAPI.JV}, n::Int64)
+    for i in 1:n
+        jv = unsafe_load(handles, i)
+        @static if isdefined(TyJuliaCAPI, :JV_DEALLOC)
+            TyJuliaCAPI.JV_DEALLOC(jv)
+        else
+            ccall(free, Cvoid, (TyJuliaCAPI.JV,), jv)
+        end
+    end
+    return nothing
+end
+
+get_free_handles() = @cfunction(free_handles, Cvoid, (Ptr{Cvoid}, Ptr{TyJuliaCAPI.JV}, Int64))
+
+
+# values whose hash cannot change, so that libjuliacall may cache it on the JV
+_hash_is_stable(x) = isbits(x) || x isa Union{String, Symbol, Module, Type}
+
+# `hash(x) % Int64` for `JV.__hash__` in one crossing; on failure the
+# exception is handed to libjuliacall in `err`
+function jl_hash(out::Ptr{Int64}, cacheable::Ptr{UInt8}, self::TyJuliaCAPI.JV, err::Ptr{TyJuliaCAPI.JV})
+    try
+        x = TyJuliaCAPI.JV_LOAD(self)
+        unsafe_store!(out, hash(x) % Int64)
+        unsafe_store!(cacheable, UInt8(_hash_is_stable(x)))
+    catch e
+        unsafe_store!(err, TyJuliaCAPI.JV_ALLOC(e))
+        return TyJuliaCAPI.ERROR
+    end
+    return TyJuliaCAPI.OK
+end
+
+get_hash() = @cfunction(jl_hash, TyJuliaCAPI.ErrorCode, (Ptr{Int64}, Ptr{UInt8}, TyJuliaCAPI.JV, Ptr{TyJuliaCAPI.JV}))
+
+# key of the identity cache of `box_julia`, see libjuliacall/include/BoxCache.hpp:
+# mutable objects do not move while a JV keeps them alive, so their address is unique
+function box_identity(jv::TyJuliaCAPI.JV)
+    x = TyJuliaCAPI.JV_LOAD(jv)
+    return ismutable(x) ? UInt64(UInt(pointer_from_objref(x))) : UInt64(0)
+end
+
+box_identity_pointer() = UInt64(UInt(@cfunction(box_identity, UInt64, (TyJuliaCAPI.JV,))))
+
 
 function boot()
-    _get_capi[] = TyJuliaCAPI.get_capi_getter()
-    _pycast2jl[] = get_pycast2jl()
-    _pycast2py[] = get_pycast2py()
-    _jl_repr_pretty[] = get_jl_repr_pretty()
-    LibJuliaCall[] = dlopen(joinpath(@__DIR__, "libjuliacall"))
-    init_LibJuliaCall = dlsym(LibJuliaCall[], :init_libjuliacall)
-    err = ccall(
-        init_LibJuliaCall,
-        Cint,
-        (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}),
-        _get_capi[], _pycast2jl[], _pycast2py[], _jl_repr_pretty[]
-    )
+    timed_phase("boot: cfunctions", "TyJuliaSetup.init") do
+        _get_capi[] = TyJuliaCAPI.get_capi_getter()
+        _pycast2jl[] = get_pycast2jl()
+        _pycast2py[] = get_pycast2py()
+        _jl_repr_pretty[] = get_jl_repr_pretty()
+        _iterate_chunk[] = get_iterate_chunk()
+        _unpack_tuple[] = get_unpack_tuple()
+        _box_numpy_scalar[] = get_box_numpy_scalar()
+        _jlapi_bootstrap[] = get_jlapi_bootstrap()
+        _free_handles[] = get_free_handles()
+        _hash[] = get_hash()
+    end
+    timed_phase("boot: dlopen libjuliacall", "TyJuliaSetup.init") do
+        LibJuliaCall[] = dlopen(joinpath(@__DIR__, "libjuliacall"))
+    end
+    err = timed_phase("boot: init_libjuliacall", "TyJuliaSetup.init") do
+        init_LibJuliaCall = dlsym(LibJuliaCall[], :init_libjuliacall)
+        ccall(
+            init_LibJuliaCall,
+            Cint,
+            (Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}, Ptr{Cvoid}),
+            _get_capi[], _pycast2jl[], _pycast2py[], _jl_repr_pretty[], _iterate_chunk[], _unpack_tuple[],
+            _box_numpy_scalar[], _jlapi_bootstrap[], cglobal(:jl_gc_total_bytes), _free_handles[], _hash[]
+        )
+    end
     if err != 0
         error("Failed to initialize LibJuliaCall")
     end
 
-    init_PyModule = dlsym(LibJuliaCall[], :init_PyModule)
-    ccall(init_PyModule, Ptr{Cvoid}, ())
+    timed_phase("boot: init_PyModule", "TyJuliaSetup.init") do
+        init_PyModule = dlsym(LibJuliaCall[], :init_PyModule)
+        ccall(init_PyModule, Ptr{Cvoid}, ())
+    end
 
     return nothing
 end
 
 precompile(boot, ())
+precompile(jlapi_bootstrap, (Ptr{TyJuliaCAPI.JV}, Int64, Ptr{TyJuliaCAPI.JV}, Int64))
+precompile(evaluate_cached, (String, Nothing, Nothing, Int64))
 
 
 
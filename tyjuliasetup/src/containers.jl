@@ -0,0 +1,93 @@
+# helpers behind JV iteration and the Mapping/Sequence proxies in jv.py
+
+struct KeyNotFound end
+
+# element types that `pycast2py` turns into a numpy array
+const NumPyElementTypes = Union{
+    Int8, Int16, Int32, Int64, UInt8, UInt16, UInt32, UInt64,
+    Float16, Float32, Float64,
+    ComplexF16, ComplexF32, ComplexF64, Bool
+}
+
+# iterator whose elements are fetched as `Vector{T}` chunks
+struct IsbitsChunks{T, I<:Iterators.Stateful}
+    it::I
+end
+
+IsbitsChunks{T}(it::I) where {T, I} = IsbitsChunks{T, I}(it)
+
+next_isbits_chunk(c::IsbitsChunks{T}, n::Integer) where T = collect(T, Iterators.take(c.it, n))
+
+const ITER_ELEMENTS = 0
+const ITER_KEYS = 1
+const ITER_VALUES = 2
+const ITER_ITEMS = 3
+const ITER_REVERSED = 4
+
+_mapping_keys(x) = keys(x)
+_mapping_keys(x::NamedTuple) = map(String, keys(x))
+
+_mapping_items(x) = ((k, v) for (k, v) in pairs(x))
+_mapping_items(x::NamedTuple) = ((String(k), v) for (k, v) in pairs(x))
+
+# lazy or stateful iterators (a `Channel`, `eachline`, generators) are stepped
+# one `iterate` per element: fetching ahead could block on elements not
+# produced yet, or consume elements the caller never asks for
+mutable struct Stepwise{I}
+    itr::I
+    state::Any
+    started::Bool
+    done::Bool
+end
+
+Stepwise(itr) = Stepwise(itr, nothing, false, false)
+
+function Base.iterate(s::Stepwise, _=nothing)
+    s.done && return nothing
+    x = s.started ? iterate(s.itr, s.state) : iterate(s.itr)
+    s.started = true
+    if x === nothing
+        s.done = true
+        return nothing
+    end
+    s.state = x[2]
+    return (x[1], nothing)
+end
+
+# finite containers, which are safe to fetch in chunks
+const ChunkedIterables = Union{AbstractArray, AbstractDict, AbstractSet, Tuple, NamedTuple}
+
+function _stateful(itr)
+    T = eltype(itr)
+    if isconcretetype(T) && T <: NumPyElementTypes
+        return IsbitsChunks{T}(Iterators.Stateful(itr))
+    end
+    return Iterators.Stateful(itr)
+end
+
+# the returned iterator is consumed chunk by chunk, either by `iterate_chunk`
+# in boot.jl or, for `IsbitsChunks`, by `next_isbits_chunk`; a `Stepwise`
+# iterator is consumed one element at a time
+function chunked_iterator(x, kind::Integer)
+    kind == ITER_KEYS && return Iterators.Stateful(_mapping_keys(x))
+    kind == ITER_VALUES && return _stateful(values(x))
+    kind == ITER_ITEMS && return Iterators.Stateful(_mapping_items(x))
+    kind == ITER_REVERSED && return _stateful(Iterators.reverse(x))
+    x isa ChunkedIterables || return Stepwise(x)
+    return _stateful(x)
+end
+
+# Python's str keys are field names of a NamedTuple
+mapping_getitem(d::AbstractDict, k) = get(d, k, KeyNotFound())
+mapping_getitem(nt::NamedTuple, k::AbstractString) = get(nt, Symbol(k), KeyNotFound())
+mapping_getitem(nt::NamedTuple, k::Symbol) = get(nt, k, KeyNotFound())
+mapping_getitem(::NamedTuple, _) = KeyNotFound()
+
+mapping_haskey(d::AbstractDict, k) = haskey(d, k)
+mapping_haskey(nt::NamedTuple, k::AbstractString) = haskey(nt, Symbol(k))
+mapping_haskey(nt::NamedTuple, k::Symbol) = haskey(nt, k)
+mapping_haskey(::NamedTuple, _) = false
+
+precompile(chunked_iterator, (Dict{Any,Any}, Int64))
+precompile(chunked_iterator, (Vector{Any}, Int64))
+precompile(chunked_iterator, (UnitRange{Int64}, Int64))
@@ -0,0 +1,73 @@
+# `JuliaEvaluator[...]`, called by `jl_eval` in libjuliacall/juliacall.cpp:
+# the same few snippets are evaluated over and over, so the parsed code of
+# each source text is kept, and so is the value of a snippet that only
+# builds a value, such as `x -> typeof(x) == Int`
+
+const EVAL_CACHE_CAPACITY = 1024
+
+mutable struct EvalEntry
+    code::Expr
+    # evaluating it has no effect but creating its value
+    pure::Bool
+    evaluated::Bool
+    value::Any
+    last_used::Int
+end
+
+# (source text, module, file name, first line)
+const _eval_cache = Dict{Tuple{String, Module, String, Int}, EvalEntry}()
+const _eval_clock = Ref(0)
+
+function _single_expression(code::Expr)
+    ex = nothing
+    for arg in code.args
+        arg isa LineNumberNode && continue
+        ex === nothing || return nothing
+        ex = arg
+    end
+    return ex
+end
+
+# literals, anonymous functions and tuples of them
+function _is_pure(ex)
+    ex isa Union{Number, Char, String, QuoteNode} && return true
+    ex isa Expr || return false
+    ex.head === :-> && return true
+    ex.head === :function && return Meta.isexpr(ex.args[1], :tuple)
+    ex.head === :tuple && return all(_is_pure, ex.args)
+    return false
+end
+
+# drops the least recently used half, so that evicting is amortized
+function _evict_eval_cache!()
+    entries = sort!(collect(_eval_cache); by = p -> p.second.last_used)
+    for i in 1:(length(entries) ÷ 2)
+        delete!(_eval_cache, entries[i].first)
+    end
+    return nothing
+end
+
+# `filename` and `line` locate the code in errors, backtraces and `methods`
+function evaluate_cached(src::String, mod::Union{Nothing, Module}=nothing, filename::Union{Nothing, String}=nothing, line::Int64=1)
+    mod = mod === nothing ? Main : mod
+    filename = filename === nothing ? "none" : filename
+    key = (src, mod, filename, Int(line))
+    entry = get(_eval_cache, key, nothing)
+    if entry === nothing
+        code = Meta.parseall(src; filename = filename, lineno = line)
+        ex = _single_expression(code)
+        entry = EvalEntry(code, ex !== nothing && _is_pure(ex), false, nothing, 0)
+        length(_eval_cache) >= EVAL_CACHE_CAPACITY && _evict_eval_cache!()
+        _eval_cache[key] = entry
+    end
+    entry.last_used = (_eval_clock[] += 1)
+    entry.evaluated && return entry.value
+    value = Core.eval(mod, entry.code)
+    if entry.pure
+        entry.value = value
+        entry.evaluated = true
+    end
+    return value
+end
+
+clear_eval_cache() = (empty!(_eval_cache); nothing)
@@ -0,0 +1,31 @@
+# support for `tyjuliacall.forkserver`
+
+const RANDOM_PKGID = Base.PkgId(Base.UUID("9a3f8284-a2c9-5f02-9a11-845980a1fd5c"), "Random")
+
+# fork() only copies the calling thread: a child that needs another Julia
+# thread (a task scheduled there, a parallel GC mark/sweep) would hang forever
+function fork_safety_issue()
+    Threads.threadid() == 1 || return "fork() must be called from Julia's main thread"
+    n = Threads.nthreads()
+    n == 1 || return "Julia runs with $n threads, start it with JULIA_NUM_THREADS=1"
+    ngc = try
+        Int(unsafe_load(cglobal(:jl_n_gcthreads, Cint)))
+    catch
+        0 # no parallel GC in this Julia version
+    end
+    ngc == 0 || return "Julia runs with $ngc parallel GC threads, set JULIA_NUM_GC_THREADS=1"
+    return nothing
+end
+
+function after_fork_child()
+    # the inherited libuv loop still shares its epoll/kqueue descriptor with the parent
+    err = ccall(:uv_loop_fork, Cint, (Ptr{Cvoid},), Base.eventloop())
+    err == 0 || error("uv_loop_fork failed: $err")
+    # workers must not replay the random stream of the server and of each other
+    Random = get(Base.loaded_modules, RANDOM_PKGID, nothing)
+    Random === nothing || Base.invokelatest(Random.seed!)
+    return nothing
+end
+
+precompile(fork_safety_issue, ())
+precompile(after_fork_child, ())
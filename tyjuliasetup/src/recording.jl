@@ -0,0 +1,39 @@
+# concrete signatures of the calls made from Python while recording is on,
+# see `record_precompiles` in tyjuliasetup/__init__.py
+const RECORDED_SIGNATURES = Set{Type}()
+
+function _call_signature(f, args::Tuple, kws)
+    argtypes = map(Core.Typeof, args)
+    isempty(kws) && return Tuple{Core.Typeof(f), argtypes...}
+    kwf = isdefined(Core, :kwcall) ? Core.kwcall : Core.kwfunc(f)
+    return Tuple{Core.Typeof(kwf), typeof(values(kws)), Core.Typeof(f), argtypes...}
+end
+
+function record_call(f, args...; kws...)
+    try
+        push!(RECORDED_SIGNATURES, _call_signature(f, args, kws))
+    catch
+    end
+    return nothing
+end
+
+function record_getattr(x, ::String)
+    push!(RECORDED_SIGNATURES, Tuple{typeof(getproperty), Core.Typeof(x), Symbol})
+    return nothing
+end
+
+# merge the recorded signatures into a precompile statements file, in the
+# format of `--trace-compile` that PackageCompiler consumes
+function write_precompiles(path::String)
+    lines = isfile(path) ? Set{String}(readlines(path)) : Set{String}()
+    for sig in RECORDED_SIGNATURES
+        push!(lines, "precompile($sig)")
+    end
+    empty!(RECORDED_SIGNATURES)
+    open(path, "w") do io
+        for line in sort!(collect(lines))
+            println(io, line)
+        end
+    end
+    return length(lines)
+end
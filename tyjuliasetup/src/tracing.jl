@@ -0,0 +1,42 @@
+# clocks and counters read by libjuliacall around the calls into Julia,
+# see `start_trace` and `start_gc_accounting` in tyjuliasetup/__init__.py
+
+trace_gc_clock() = UInt64(Base.gc_time_ns())
+
+function trace_compile_clock()
+    @static if isdefined(Base, :cumulative_compile_time_ns)
+        return UInt64(first(Base.cumulative_compile_time_ns()))
+    else
+        return UInt64(0)
+    end
+end
+
+function _set_compile_timing(on::Bool)
+    @static if isdefined(Base, :cumulative_compile_timing)
+        Base.cumulative_compile_timing(on)
+    end
+    return nothing
+end
+
+# addresses of the clocks as `uint64_t (*)(void)`, and turns on compilation timing
+function start_trace_clocks()
+    _set_compile_timing(true)
+    return (
+        UInt64(UInt(@cfunction(trace_gc_clock, UInt64, ()))),
+        UInt64(UInt(@cfunction(trace_compile_clock, UInt64, ()))),
+    )
+end
+
+stop_trace_clocks() = _set_compile_timing(false)
+
+# keep in sync with `GCCounter` in libjuliacall/include/Stats.hpp
+function gc_snapshot(out::Ptr{Int64})
+    num = Base.gc_num()
+    unsafe_store!(out, Int64(Base.gc_total_bytes(num)), 1)
+    unsafe_store!(out, Int64(num.malloc + num.realloc + num.poolalloc + num.bigalloc), 2)
+    unsafe_store!(out, Int64(num.total_time), 3)
+    unsafe_store!(out, Int64(num.pause), 4)
+    return nothing
+end
+
+gc_snapshot_pointer() = UInt64(UInt(@cfunction(gc_snapshot, Cvoid, (Ptr{Int64},))))